@@ -64,10 +64,13 @@ namespace array {
     DynamicArray<T> da{
         ._size         = size,
         ._capacity     = capacity,
-        ._data         = arena::alloc<T>(a, sizeof(T) * capacity),
+        ._data         = arena::alloc_uninit<T>(a, sizeof(T) * capacity),
         ._arena_handle = a,
     };
 
+    // the rest of the capacity is written before it is read
+    memset(static_cast<void*>(da._data), 0, sizeof(T) * size);
+
     return da;
   }
 
@@ -77,7 +80,7 @@ namespace array {
     DynamicArray<T> da{
         ._size         = size,
         ._capacity     = size,
-        ._data         = arena::alloc<T>(a, sizeof(T) * size),
+        ._data         = arena::alloc_uninit<T>(a, sizeof(T) * size),
         ._arena_handle = a,
     };
 
@@ -97,7 +100,7 @@ namespace array {
     DynamicArray<T> da{
         ._size         = size,
         ._capacity     = size,
-        ._data         = arena::alloc<T>(a, sizeof(T) * size),
+        ._data         = arena::alloc_uninit<T>(a, sizeof(T) * size),
         ._arena_handle = a,
     };
 
@@ -111,7 +114,7 @@ namespace array {
     DynamicArray<T> da{
         ._size         = other._size,
         ._capacity     = other._size,
-        ._data         = arena::alloc<T>(a, sizeof(T) * other._size),
+        ._data         = arena::alloc_uninit<T>(a, sizeof(T) * other._size),
         ._arena_handle = a,
     };
 
@@ -126,7 +129,7 @@ namespace array {
 
     if (da._capacity < new_capacity) {
       T* old_data = da._data;
-      da._data    = arena::alloc<T>(da._arena_handle, sizeof(T) * new_capacity);
+      da._data    = arena::alloc_uninit<T>(da._arena_handle, sizeof(T) * new_capacity);
       memcpy(da._data, old_data, da._size * sizeof(da._data[0]));
       da._capacity = new_capacity;
     }
@@ -16,16 +16,10 @@ struct StaticArray {
 namespace array {
   template <typename T, U32 SIZE>
   StaticArray<T, SIZE> init(ArenaHandle arena_handle, T init_value = T{}) {
-    auto sa = StaticArray<T, SIZE>{
+    return StaticArray<T, SIZE>{
         .size = SIZE,
-        .data = arena::alloc<T>(arena_handle, sizeof(T) * SIZE),
+        .data = arena::alloc_fill<T>(arena_handle, SIZE, init_value),
     };
-
-    for (U32 i = 0; i < SIZE; ++i) {
-      sa.data[i] = init_value;
-    }
-
-    return sa;
   }
 
   template <typename T, U32 SIZE>
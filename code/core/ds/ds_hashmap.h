@@ -204,7 +204,7 @@ namespace hashmap {
     THashMap<K, empty_value, V> hm{
         ._size     = 0,
         ._capacity = capacity,
-        ._data     = arena::alloc<typename THashMap<K, empty_value, V>::KeyValue>(
+        ._data     = arena::alloc_uninit<typename THashMap<K, empty_value, V>::KeyValue>(
             arena_handle,
             capacity * sizeof(typename THashMap<K, empty_value, V>::KeyValue)),
         ._arena_handle = arena_handle,
@@ -259,7 +259,7 @@ namespace hashmap {
     hm._size          = 0;
     hm._capacity *= 2;
 
-    hm._data = arena::alloc<typename THashMap<K, empty_value, V>::KeyValue>(
+    hm._data = arena::alloc_uninit<typename THashMap<K, empty_value, V>::KeyValue>(
         hm._arena_handle,
         hm._capacity * sizeof(typename THashMap<K, empty_value, V>::KeyValue));
 
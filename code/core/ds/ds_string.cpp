@@ -9,7 +9,7 @@ String string::init(ArenaHandle arena_handle) {
   String s{
       ._size         = 1,
       ._capacity     = 16,
-      ._data         = arena::alloc<char>(arena_handle, 16),
+      ._data         = arena::alloc_uninit<char>(arena_handle, 16),
       ._arena_handle = arena_handle,
   };
 
@@ -27,7 +27,7 @@ String string::init(ArenaHandle arena_handle, const char* cstr) {
   String s{
       ._size         = size,
       ._capacity     = capacity,
-      ._data         = arena::alloc<char>(arena_handle, capacity),
+      ._data         = arena::alloc_uninit<char>(arena_handle, capacity),
       ._arena_handle = arena_handle,
   };
 
@@ -42,7 +42,7 @@ String string::init(ArenaHandle arena_handle, const String& str) {
   String s{
       ._size         = str._size,
       ._capacity     = str._capacity,
-      ._data         = arena::alloc<char>(arena_handle, capacity),
+      ._data         = arena::alloc_uninit<char>(arena_handle, capacity),
       ._arena_handle = arena_handle,
   };
 
@@ -57,11 +57,12 @@ String string::init(ArenaHandle arena_handle, const char* chars, U32 size) {
   String s{
       ._size         = size,
       ._capacity     = capacity,
-      ._data         = arena::alloc<char>(arena_handle, capacity),
+      ._data         = arena::alloc_uninit<char>(arena_handle, capacity),
       ._arena_handle = arena_handle,
   };
 
   strncpy(s._data, chars, size);
+  s._data[size] = '\0';
 
   return s;
 }
@@ -70,7 +71,7 @@ String string::init(ArenaHandle arena_handle, const char c) {
   String s{
       ._size         = 1,
       ._capacity     = 2,
-      ._data         = arena::alloc<char>(arena_handle, 2),
+      ._data         = arena::alloc_uninit<char>(arena_handle, 2),
       ._arena_handle = arena_handle,
   };
   s._data[0] = c;
@@ -109,7 +110,7 @@ String operator+(const String& lhs, const String& rhs) {
   String s{
       ._size         = lhs._size + rhs._size,
         ._capacity     = capacity,
-      ._data         = arena::alloc<char>(lhs._arena_handle, capacity),
+      ._data         = arena::alloc_uninit<char>(lhs._arena_handle, capacity),
       ._arena_handle = lhs._arena_handle,
   };
 
@@ -125,7 +126,7 @@ String operator+(const String& lhs, const char* rhs) {
 
   String s{
       ._size         = lhs._size + rhs_size,
-      ._data         = arena::alloc<char>(lhs._arena_handle, capacity),
+      ._data         = arena::alloc_uninit<char>(lhs._arena_handle, capacity),
       ._arena_handle = lhs._arena_handle,
   };
 
@@ -138,7 +139,7 @@ String operator+(const String& lhs, const char* rhs) {
 String& operator+=(String& lhs, const String& rhs) {
   auto capacity = lhs._size + rhs._size + 1;
 
-  char* new_data = arena::alloc<char>(lhs._arena_handle, capacity);
+  char* new_data = arena::alloc_uninit<char>(lhs._arena_handle, capacity);
   memcpy(new_data, lhs._data, lhs._size);
   strcpy(new_data + lhs._size, rhs._data);
   lhs._data = new_data;
@@ -152,7 +153,7 @@ String& operator+=(String& lhs, const char* rhs) {
   U32   rhs_size = strlen(rhs);
   auto capacity = lhs._size + strlen(rhs) + 1;
 
-  char* new_data = arena::alloc<char>(lhs._arena_handle,capacity);
+  char* new_data = arena::alloc_uninit<char>(lhs._arena_handle,capacity);
   memcpy(new_data, lhs._data, lhs._size);
   strcpy(new_data + lhs._size, rhs);
   lhs._data = new_data;
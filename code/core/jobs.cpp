@@ -0,0 +1,121 @@
+#include "jobs.h"
+
+#include "arena.h"
+#include "types.h"
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdio>
+#include <mutex>
+#include <thread>
+
+namespace {
+  const U32 MAX_THREADS = 64;
+
+  std::thread _workers[MAX_THREADS];
+  U32         _thread_count = 1;
+
+  std::mutex              _mutex;
+  std::condition_variable _wake;
+  std::condition_variable _done;
+
+  U64  _generation = 0;
+  bool _quit       = false;
+
+  jobs::JobFn      _fn    = nullptr;
+  U32              _count = 0;
+  std::atomic<U32> _next{0};
+  std::atomic<U32> _busy_workers{0};
+
+  void _run() {
+    for (U32 i = _next.fetch_add(1); i < _count; i = _next.fetch_add(1)) {
+      _fn(i);
+    }
+  }
+
+  void _worker_loop() {
+    U64 seen_generation = 0;
+
+    // jobs that allocate from scratch or frame get arenas of their own
+    arena::init_thread();
+
+    for (;;) {
+      {
+        std::unique_lock lock(_mutex);
+        _wake.wait(lock,
+                   [&] { return _quit || _generation != seen_generation; });
+
+        if (_quit) return;
+
+        seen_generation = _generation;
+      }
+
+      _run();
+
+      if (_busy_workers.fetch_sub(1) == 1) {
+        std::lock_guard lock(_mutex);
+        _done.notify_one();
+      }
+    }
+  }
+}
+
+void jobs::init(U32 thread_count) {
+  if (_thread_count > 1) cleanup();
+
+  if (thread_count == 0) thread_count = std::thread::hardware_concurrency();
+  if (thread_count == 0) thread_count = 1;
+  if (thread_count > MAX_THREADS) thread_count = MAX_THREADS;
+
+  _quit         = false;
+  _thread_count = thread_count;
+
+  for (U32 i = 0; i < _thread_count - 1; ++i) {
+    _workers[i] = std::thread(_worker_loop);
+  }
+
+  printf("TENGINE - JOBS INITIALIZED WITH %u THREADS\n", _thread_count);
+}
+
+void jobs::cleanup() {
+  {
+    std::lock_guard lock(_mutex);
+    _quit = true;
+  }
+  _wake.notify_all();
+
+  for (U32 i = 0; i < _thread_count - 1; ++i) {
+    _workers[i].join();
+  }
+
+  // workers of the next init start from generation 0, they would take a
+  // leftover one for a new pass
+  _generation   = 0;
+  _thread_count = 1;
+}
+
+U32 jobs::thread_count() { return _thread_count; }
+
+void jobs::parallel_for(U32 count, JobFn fn) {
+  if (_thread_count == 1 || count <= 1) {
+    for (U32 i = 0; i < count; ++i) {
+      fn(i);
+    }
+    return;
+  }
+
+  {
+    std::lock_guard lock(_mutex);
+    _fn           = fn;
+    _count        = count;
+    _next         = 0;
+    _busy_workers = _thread_count - 1;
+    ++_generation;
+  }
+  _wake.notify_all();
+
+  _run();
+
+  std::unique_lock lock(_mutex);
+  _done.wait(lock, [] { return _busy_workers.load() == 0; });
+}
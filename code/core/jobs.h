@@ -0,0 +1,17 @@
+#pragma once
+
+#include "types.h"
+
+namespace jobs {
+  typedef void (*JobFn)(U32 index);
+
+  // thread_count includes the calling thread, 0 means one per core
+  void init(U32 thread_count = 0);
+  void cleanup();
+
+  U32 thread_count();
+
+  // runs fn(0..count-1) spread over the pool and blocks until all are done.
+  // workers have scratch and frame arenas of their own, see arena::init_thread
+  void parallel_for(U32 count, JobFn fn);
+}
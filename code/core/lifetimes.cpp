@@ -0,0 +1,65 @@
+#include "lifetimes.h"
+
+#include "arena.h"
+#include "lifetime.h"
+#include "types.h"
+
+#include <array>
+#include <cassert>
+#include <utility>
+
+namespace {
+  const U8 COUNT = std::to_underlying(LifeTime::COUNT);
+
+  // the full lifetime shares the arena that holds everything the renderer
+  // keeps for the whole run
+  const char* ARENA_NAMES[COUNT] = {"render", "level", "frame0", "frame1", "frame2"};
+
+  void (*_hooks[lifetime::MAX_RELEASE_HOOKS])(LifeTime lifetime) = {};
+  U8 _hook_count                                                 = 0;
+}
+
+ArenaHandle lifetime::arena(LifeTime lifetime) {
+  assert(lifetime < LifeTime::COUNT && "Invalid lifetime");
+
+  // looked up once, by_name takes the registry lock
+  static const std::array<ArenaHandle, COUNT> arenas = [] {
+    std::array<ArenaHandle, COUNT> handles;
+
+    for (U8 i = 0; i < COUNT; ++i) {
+      handles[i] = arena::by_name(ARENA_NAMES[i]);
+    }
+
+    return handles;
+  }();
+
+  return arenas[std::to_underlying(lifetime)];
+}
+
+LifeTime lifetime::frame(U8 frame_index) {
+  assert(frame_index < COUNT - std::to_underlying(LifeTime::FRAME0) && "Invalid frame index");
+
+  return LifeTime(std::to_underlying(LifeTime::FRAME0) + frame_index);
+}
+
+U8* lifetime::alloc(LifeTime lifetime, U32 size, U8 align, std::source_location site) {
+  return arena::alloc(arena(lifetime), size, align, site);
+}
+
+U8* lifetime::alloc_uninit(LifeTime lifetime, U32 size, U8 align, std::source_location site) {
+  return arena::alloc_uninit(arena(lifetime), size, align, site);
+}
+
+void lifetime::on_release(void (*hook)(LifeTime lifetime)) {
+  assert(_hook_count < MAX_RELEASE_HOOKS && "ran out of release hooks!");
+
+  _hooks[_hook_count++] = hook;
+}
+
+void lifetime::release(LifeTime lifetime) {
+  for (U8 i = _hook_count; i > 0; --i) {
+    _hooks[i - 1](lifetime);
+  }
+
+  if (lifetime != LifeTime::FULL) arena::reset(arena(lifetime));
+}
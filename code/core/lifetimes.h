@@ -0,0 +1,56 @@
+#pragma once
+
+#include "arena.h"
+#include "lifetime.h"
+#include "types.h"
+
+#include <source_location>
+
+// memory and resources by how long they live. each lifetime has an arena,
+// "render", "level" and "frame0" to "frame2", and systems that hand out
+// handles register a release hook. release drops everything of a lifetime
+// at once, so nothing that lives for a level or a frame needs a cleanup
+// call of its own
+namespace lifetime {
+  const U8 MAX_RELEASE_HOOKS = 16;
+
+  ArenaHandle arena(LifeTime lifetime);
+
+  // the lifetime of the frame in flight with this index
+  LifeTime frame(U8 frame_index);
+
+  U8* alloc(LifeTime             lifetime,
+            U32                  size,
+            U8                   align = arena::DEFAULT_ALIGNMENT,
+            std::source_location site  = std::source_location::current());
+  U8* alloc_uninit(LifeTime             lifetime,
+                   U32                  size,
+                   U8                   align = arena::DEFAULT_ALIGNMENT,
+                   std::source_location site  = std::source_location::current());
+
+  // hooks run on release in the reverse order they were added, so systems
+  // that build on others let go first. add them at init, before any thread
+  // could release
+  void on_release(void (*hook)(LifeTime lifetime));
+
+  // runs the hooks and resets the lifetime's arena, except the full one
+  // which backs the whole run. handles and memory of the lifetime are
+  // stale afterwards
+  void release(LifeTime lifetime);
+
+  template <typename T>
+  T* alloc(LifeTime             lifetime,
+           U32                  size,
+           U8                   align = arena::DEFAULT_ALIGNMENT,
+           std::source_location site  = std::source_location::current()) {
+    return reinterpret_cast<T*>(alloc(lifetime, size, align, site));
+  }
+
+  template <typename T>
+  T* alloc_uninit(LifeTime             lifetime,
+                  U32                  size,
+                  U8                   align = arena::DEFAULT_ALIGNMENT,
+                  std::source_location site  = std::source_location::current()) {
+    return reinterpret_cast<T*>(alloc_uninit(lifetime, size, align, site));
+  }
+}
@@ -3,6 +3,8 @@
 #include "handles.h"
 #include "types.h"
 
+#include <algorithm>
+#include <atomic>
 #include <cassert>
 #include <cstdio>
 #include <cstdlib>
@@ -11,11 +13,15 @@
 #include <cxxabi.h>
 #include <cstdlib>
 #include <cstdio>
+#include <mutex>
 #include <string>
+#include <sys/mman.h>
 #include <regex>
 
 namespace {
-  const U8 MAX_ARENA_COUNT = U8_MAX;
+  const U8  MAX_ARENA_COUNT = U8_MAX;
+  const U8  FRAME_COUNT     = 3;
+  const U32 MAX_THREADS     = 64;
 
   ArenaHandle current_frame_arena = ArenaHandle{.value = 0};
 
@@ -23,8 +29,89 @@ namespace {
     const char* name = "";
     ArenaHandle handle;
     Arena       a;
+    bool        shared;
+    U32         commit_size;
+    ArenaStats  stats;
+    U64         dumped_allocs;
   } _arenas[MAX_ARENA_COUNT] = {{}};
 
+  // guards names in _arenas and the thread slots
+  std::mutex _registry;
+
+  // guards committing pages of reserved arenas
+  std::mutex _commits;
+
+  // a thread counts its allocs from a shared arena here and adds them to
+  // the arena's stats a batch at a time, an atomic add per counter and alloc
+  // would cost more than the alloc. stats lag by up to a batch per thread
+  const U32 STATS_BATCH = 64;
+
+  struct PendingStats {
+    ArenaHandle handle;
+    U32         allocs;
+    U64         bytes;
+    U64         wasted;
+  };
+
+  thread_local PendingStats _pending;
+
+  void flush_pending() {
+    if (_pending.allocs == 0) return;
+
+    auto& stats = _arenas[_pending.handle.value].stats;
+
+    std::atomic_ref<U64>(stats.allocs).fetch_add(_pending.allocs, std::memory_order_relaxed);
+    std::atomic_ref<U64>(stats.bytes).fetch_add(_pending.bytes, std::memory_order_relaxed);
+    std::atomic_ref<U64>(stats.wasted).fetch_add(_pending.wasted, std::memory_order_relaxed);
+
+    _pending.allocs = 0;
+    _pending.bytes  = 0;
+    _pending.wasted = 0;
+  }
+
+#ifdef ARENA_TRACK_SITES
+  const U32 MAX_SITES = 1024;
+
+  // open addressed by arena, file and line. sites past MAX_SITES are not
+  // counted. every alloc takes the lock, so it is opt in
+  struct Site {
+    ArenaHandle handle;
+    ArenaSite   site;
+  } _sites[MAX_SITES] = {};
+
+  std::mutex _sites_lock;
+#endif
+
+  // set_frame bumps the generation, a thread resets its own frame arena the
+  // first time it asks for it in a new frame
+  std::atomic<U8>  _frame_index{0};
+  std::atomic<U32> _frame_generation{0};
+
+  // arenas of a thread that called init_thread. slots outlive their threads
+  // and are handed to the next one, so restarting the job pool doesn't carve
+  // out new arenas every time
+  struct ThreadArenas {
+    bool        taken;
+    ArenaHandle scratch;
+    ArenaHandle frames[FRAME_COUNT];
+    U32         generation;
+  } _threads[MAX_THREADS] = {};
+
+  struct ThreadSlot {
+    ThreadArenas* arenas = nullptr;
+
+    ~ThreadSlot() {
+      if (arenas == nullptr) return;
+
+      flush_pending();
+
+      std::lock_guard lock(_registry);
+      arenas->taken = false;
+    }
+  };
+
+  thread_local ThreadSlot _thread;
+
   bool is_power_of_two(uintptr_t x) { return (x & (x - 1)) == 0; }
 
   uintptr_t align_forward(U8* ptr, U8 align) {
@@ -40,12 +127,177 @@ namespace {
 
     return p;
   }
+
+  // returns UINTPTR_MAX when the arena is full. skipped is what the alignment
+  // left unused
+  uintptr_t bump_shared(Arena* a, U32 size, U8 align, uintptr_t& skipped) {
+    std::atomic_ref<uintptr_t> curr_offset(a->curr_offset);
+    std::atomic_ref<U64>       buf_len(a->buf_len);
+
+    uintptr_t offset = curr_offset.load(std::memory_order_relaxed);
+    uintptr_t start;
+
+    do {
+      start = align_forward(a->buf + offset, align) - reinterpret_cast<uintptr_t>(a->buf);
+
+      if (start + size >= buf_len.load(std::memory_order_acquire)) return UINTPTR_MAX;
+    } while (!curr_offset.compare_exchange_weak(offset, start + size, std::memory_order_relaxed));
+
+    skipped = start - offset;
+
+    return start;
+  }
+
+  // commits pages of a reserved arena until more than size bytes are usable.
+  // false when size is past the reservation or the arena is a fixed buffer
+  bool commit(ArenaHandle handle, uintptr_t size) {
+    auto a = &_arenas[handle.value].a;
+
+    std::lock_guard lock(_commits);
+    std::atomic_ref<U64> buf_len(a->buf_len);
+
+    U64 committed = buf_len.load(std::memory_order_relaxed);
+
+    if (size < committed) return true;
+    if (size >= a->reserved) return false;
+
+    U64 step = _arenas[handle.value].commit_size;
+    U64 end  = std::min((size + step) / step * step, a->reserved);
+
+    if (mprotect(a->buf + committed, end - committed, PROT_READ | PROT_WRITE) != 0) {
+      printf("Could not commit memory in this arena. Name of arena: '%s'\n",
+             _arenas[handle.value].name);
+      return false;
+    }
+
+    buf_len.store(end, std::memory_order_release);
+
+    return true;
+  }
+
+  void count(ArenaHandle handle, U32 size, uintptr_t skipped, const std::source_location& site) {
+    auto& stats = _arenas[handle.value].stats;
+
+    if (_arenas[handle.value].shared) {
+      if (_pending.handle != handle) {
+        flush_pending();
+        _pending.handle = handle;
+      }
+
+      ++_pending.allocs;
+      _pending.bytes += size;
+      _pending.wasted += skipped;
+
+      if (_pending.allocs == STATS_BATCH) flush_pending();
+    } else {
+      ++stats.allocs;
+      stats.bytes += size;
+      stats.wasted += skipped;
+    }
+
+#ifdef ARENA_TRACK_SITES
+    std::lock_guard lock(_sites_lock);
+
+    U32 index = (std::hash<std::string_view>{}(site.file_name()) ^ site.line() * 0x9e3779b1u ^
+                 handle.value) %
+                MAX_SITES;
+
+    for (U32 probe = 0; probe < MAX_SITES; ++probe, index = (index + 1) % MAX_SITES) {
+      auto& entry = _sites[index];
+
+      if (entry.site.file == nullptr) {
+        entry.handle    = handle;
+        entry.site.file = site.file_name();
+        entry.site.line = site.line();
+      } else if (entry.handle != handle || entry.site.line != site.line() ||
+                 strcmp(entry.site.file, site.file_name()) != 0) {
+        continue;
+      }
+
+      ++entry.site.allocs;
+      entry.site.bytes += size;
+      return;
+    }
+#endif
+  }
+
+  void print_stats(const ArenaStats& stats) {
+    printf("'%s': %llu of %llu bytes used, peak %llu, %llu allocs of %llu bytes, %llu wasted to "
+           "alignment\n",
+           stats.name,
+           (unsigned long long)stats.used,
+           (unsigned long long)stats.capacity,
+           (unsigned long long)stats.peak,
+           (unsigned long long)stats.allocs,
+           (unsigned long long)stats.bytes,
+           (unsigned long long)stats.wasted);
+  }
+
+  // prints what is known about an arena that ran out and who filled it
+  void overflow(ArenaHandle handle, U32 size) {
+    printf("Memory is out of bounds of the buffer in this arena. Name of arena: '%s'\n",
+           _arenas[handle.value].name);
+    printf("asked for %u bytes, ", size);
+    print_stats(arena::stats(handle));
+
+    const U32 TOP_SITES = 8;
+
+    ArenaSite top[TOP_SITES];
+    U32       count = arena::sites(handle, top, TOP_SITES);
+
+    for (U32 i = 0; i < count; ++i) {
+      printf("  %s:%u %llu allocs %llu bytes\n",
+             top[i].file,
+             top[i].line,
+             (unsigned long long)top[i].allocs,
+             (unsigned long long)top[i].bytes);
+    }
+  }
+
+  ArenaHandle find_or_add(const char* name) {
+    for (U8 i = 1; i < MAX_ARENA_COUNT; ++i) {
+      if (_arenas[i].name[0] == '\0') break;
+
+      if (strcmp(_arenas[i].name, name) == 0) {
+        return ArenaHandle{.value = i};
+      }
+    }
+
+    for (U8 i = 1; i < MAX_ARENA_COUNT; ++i) {
+      if (_arenas[i].name[0] == '\0') {
+        _arenas[i].name = name;
+        return ArenaHandle{.value = i};
+      }
+    }
+
+    assert(false && "ran out of arena allocators!");
+    return ArenaHandle{};
+  }
+
+  // a thread's arenas are cut from the shared "threads" arena and named
+  // after their slot, like "scratch.3"
+  ArenaHandle carve(const char* kind, U32 size) {
+    static ArenaHandle threads = [] {
+      auto handle = arena::by_name("threads");
+      arena::share(handle);
+      return handle;
+    }();
+
+    const U32 NAME_SIZE = 32;
+
+    auto name = arena::alloc<char>(threads, NAME_SIZE);
+    snprintf(name, NAME_SIZE, "%s.%u", kind, U32(_thread.arenas - _threads));
+
+    return arena::set(name, arena::alloc(threads, size), size);
+  }
 }
 
 ArenaHandle arena::set(const char* name, U8* mem, U32 mem_size) {
+  std::lock_guard lock(_registry);
+
   U8 index = 0;
   if (strcmp(name, "scratch") != 0) {
-    index = by_name(name).value;
+    index = find_or_add(name).value;
   }
 
   _arenas[index].name          = name;
@@ -65,32 +317,110 @@ void arena::set_scratch(U8* mem, U32 size) {
   _arenas[0].a.prev_offset = 0;
 }
 
-ArenaHandle arena::by_name(const char* name) {
-  for (U8 i = 1; i < MAX_ARENA_COUNT; ++i) {
-    if (_arenas[i].name[0] == '\0') break;
+ArenaHandle arena::reserve(const char* name, U64 size, bool huge_pages) {
+  U32 commit_size = huge_pages ? HUGE_COMMIT_SIZE : COMMIT_SIZE;
+
+  size = (size + commit_size - 1) / commit_size * commit_size;
+
+  // huge pages only back ranges aligned to their size, reserve one more and
+  // start at the first aligned address
+  U64  padding = huge_pages ? HUGE_COMMIT_SIZE : 0;
+  auto mem     = mmap(nullptr,
+                  size + padding,
+                  PROT_NONE,
+                  MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE,
+                  -1,
+                  0);
+
+  if (mem == MAP_FAILED) {
+    printf("Could not reserve %llu bytes for arena '%s'\n", (unsigned long long)size, name);
+    assert(false);
+    return ArenaHandle{};
+  }
 
-    if (strcmp(_arenas[i].name, name) == 0) {
-      return ArenaHandle{.value = i};
-    }
+  auto buf = reinterpret_cast<U8*>(mem);
+
+  if (huge_pages) {
+    auto start = reinterpret_cast<uintptr_t>(mem);
+    buf        = reinterpret_cast<U8*>((start + padding - 1) / padding * padding);
+
+    madvise(buf, size, MADV_HUGEPAGE);
   }
 
-  for (U8 i = 1; i < MAX_ARENA_COUNT; ++i) {
-    if (_arenas[i].name[0] == '\0') {
-      _arenas[i].name = name;
-      return ArenaHandle{.value = i};
-    }
+  std::lock_guard lock(_registry);
+
+  auto handle = find_or_add(name);
+
+  _arenas[handle.value].commit_size = commit_size;
+  _arenas[handle.value].a           = Arena{.buf = buf, .buf_len = 0, .reserved = size};
+
+  return handle;
+}
+
+ArenaHandle arena::by_name(const char* name) {
+  std::lock_guard lock(_registry);
+
+  return find_or_add(name);
+}
+
+void arena::share(ArenaHandle handle) { _arenas[handle.value].shared = true; }
+
+void arena::init_thread() {
+  std::lock_guard lock(_registry);
+
+  for (U32 i = 0; i < MAX_THREADS; ++i) {
+    if (_threads[i].taken) continue;
+
+    _threads[i].taken = true;
+    _thread.arenas    = &_threads[i];
+
+    return;
   }
 
-  assert(false && "ran out of arena allocators!");
+  assert(false && "ran out of thread arena slots!");
+}
+
+ArenaHandle arena::scratch() {
+  if (_thread.arenas == nullptr) return ArenaHandle{.value = 0};
+
+  auto& scratch = _thread.arenas->scratch;
+
+  if (handles::invalid(scratch)) scratch = carve("scratch", THREAD_SCRATCH_SIZE);
+
+  return scratch;
 }
 
-ArenaHandle arena::frame() { return current_frame_arena; }
+ArenaHandle arena::frame() {
+  if (_thread.arenas == nullptr) return current_frame_arena;
+
+  auto  arenas     = _thread.arenas;
+  U8    index      = _frame_index.load(std::memory_order_relaxed);
+  U32   generation = _frame_generation.load(std::memory_order_relaxed);
+  auto& frame      = arenas->frames[index];
+
+  if (handles::invalid(frame)) {
+    char kind[] = "frame0";
+    kind[5] += index;
+
+    frame = carve(kind, THREAD_FRAME_SIZE);
+  } else if (arenas->generation != generation) {
+    reset(frame);
+  }
+
+  arenas->generation = generation;
+
+  return frame;
+}
 
 void arena::set_frame(U8 arena_index) {
+  _frame_index.store(arena_index, std::memory_order_relaxed);
+  _frame_generation.fetch_add(1, std::memory_order_relaxed);
+
   switch (arena_index) {
     case 0:
       static ArenaHandle frame0 = arena::by_name("frame0");
       current_frame_arena = frame0;
+      break;
     case 1:
       static ArenaHandle frame1 = arena::by_name("frame1");
       current_frame_arena = frame1;
@@ -104,53 +434,96 @@ void arena::set_frame(U8 arena_index) {
   }
 }
 
-U8* arena::alloc(ArenaHandle handle, U32 size, U8 align) {
+U8* arena::alloc(ArenaHandle handle, U32 size, U8 align, std::source_location site) {
+  U8* ptr = alloc_uninit(handle, size, align, site);
+
+  memset(ptr, 0, size);
+
+  return ptr;
+}
+
+U8* arena::alloc_uninit(ArenaHandle handle, U32 size, U8 align, std::source_location site) {
   assert(size > 0 && "Size must be greater than 0");
-  if (_arenas[handle.value].a.buf_len == 0) {
+  if (_arenas[handle.value].a.buf == nullptr) {
     printf("arena '%s' has not been set up", _arenas[handle.value].name);
     exit(0);
   }
   auto a = &_arenas[handle.value].a;
 
+  if (_arenas[handle.value].shared) {
+    uintptr_t skipped;
+    uintptr_t offset = bump_shared(a, size, align, skipped);
+
+    // a failed bump only tells the arena is full for what was there, commit
+    // for the worst case alignment and try again
+    while (offset == UINTPTR_MAX &&
+           commit(handle,
+                  std::atomic_ref<uintptr_t>(a->curr_offset).load(std::memory_order_relaxed) +
+                      size + align)) {
+      offset = bump_shared(a, size, align, skipped);
+    }
+
+    if (offset != UINTPTR_MAX) {
+      count(handle, size, skipped, site);
+      return &a->buf[offset];
+    }
+
+    overflow(handle, size);
+    assert(false);
+    return nullptr;
+  }
+
   auto      curr_ptr = a->buf + a->curr_offset;
   uintptr_t offset   = align_forward(curr_ptr, align);
   offset -= reinterpret_cast<uintptr_t>(a->buf);
 
-  if (offset + size < a->buf_len) {
+  if (offset + size < a->buf_len || commit(handle, offset + size)) {
+    count(handle, size, offset - a->curr_offset, site);
+
     U8* ptr        = &a->buf[offset];
     a->prev_offset = offset;
     a->curr_offset = offset + size;
 
-    memset(ptr, 0, size);
-
     return ptr;
   }
 
-  printf("Memory is out of bounds of the buffer in this arena. Name of arena: '%s'\n",
-         _arenas[handle.value].name);
+  overflow(handle, size);
   assert(false);
   return nullptr;
 }
 
-U8* arena::resize(ArenaHandle handle, U8* old_mem, U32 old_size, U32 new_size, U8 align) {
+U8* arena::resize(ArenaHandle          handle,
+                  U8*                  old_mem,
+                  U32                  old_size,
+                  U32                  new_size,
+                  U8                   align,
+                  std::source_location site) {
   assert(is_power_of_two(align));
 
   auto a = &_arenas[handle.value].a;
 
   if (old_mem == nullptr || old_size == 0) {
-    return alloc(handle, new_size, align);
+    return alloc(handle, new_size, align, site);
   } else if (a->buf <= old_mem && old_mem < a->buf + a->buf_len) {
-    if (a->buf + a->prev_offset == old_mem) {
+    bool last = !_arenas[handle.value].shared && a->buf + a->prev_offset == old_mem;
+
+    // the last allocation grows in place as long as the arena has or can
+    // commit the room
+    if (last && (a->prev_offset + new_size < a->buf_len ||
+                 commit(handle, a->prev_offset + new_size))) {
       a->curr_offset = a->prev_offset + new_size;
       if (new_size > old_size) {
-        memset(&a->buf[a->curr_offset], 0, new_size - old_size);
+        memset(old_mem + old_size, 0, new_size - old_size);
       }
       return old_mem;
     } else {
-      U8*    new_mem   = alloc(handle, new_size, align);
+      U8*    new_mem   = alloc_uninit(handle, new_size, align, site);
       size_t copy_size = old_size < new_size ? old_size : new_size;
 
       memmove(new_mem, old_mem, copy_size);
+      if (new_size > old_size) {
+        memset(new_mem + old_size, 0, new_size - old_size);
+      }
 
       return new_mem;
     }
@@ -163,8 +536,92 @@ U8* arena::resize(ArenaHandle handle, U8* old_mem, U32 old_size, U32 new_size, U
 
 void arena::reset(ArenaHandle handle) {
   // printf("Resetting arena '%s'\n", _arenas[handle.value].name);
+  restore(ArenaMark{.handle = handle, .prev_offset = 0, .curr_offset = 0});
+}
+
+ArenaMark arena::mark(ArenaHandle handle) {
   auto a = &_arenas[handle.value].a;
 
-  a->curr_offset = 0;
-  a->prev_offset = 0;
+  return ArenaMark{
+      .handle      = handle,
+      .prev_offset = a->prev_offset,
+      .curr_offset = a->curr_offset,
+  };
+}
+
+void arena::restore(ArenaMark mark) {
+  auto a     = &_arenas[mark.handle.value].a;
+  auto stats = &_arenas[mark.handle.value].stats;
+
+  stats->peak = std::max<U64>(stats->peak, a->curr_offset);
+
+  assert(mark.curr_offset <= a->curr_offset && "arena restored past a newer mark");
+
+#ifndef NDEBUG
+  memset(a->buf + mark.curr_offset, POISON, a->curr_offset - mark.curr_offset);
+#endif
+
+  a->curr_offset = mark.curr_offset;
+  a->prev_offset = mark.prev_offset;
+}
+
+ArenaStats arena::stats(ArenaHandle handle) {
+  flush_pending();
+
+  auto entry = &_arenas[handle.value];
+  auto stats = &entry->stats;
+
+  stats->peak     = std::max<U64>(stats->peak, entry->a.curr_offset);
+  stats->name     = entry->name;
+  stats->used     = entry->a.curr_offset;
+  stats->capacity = entry->a.reserved ? entry->a.reserved : entry->a.buf_len;
+
+  return *stats;
+}
+
+void arena::dump() {
+  printf("arenas:");
+
+  for (U32 i = 0; i < MAX_ARENA_COUNT; ++i) {
+    if (_arenas[i].a.buf == nullptr) continue;
+
+    auto stats = arena::stats(ArenaHandle{.value = U8(i)});
+    bool full  = stats.peak > FULL_WARNING * stats.capacity;
+
+    printf(" %s%s %lluk/%lluk peak %lluk +%llu",
+           full ? "!" : "",
+           stats.name,
+           (unsigned long long)stats.used >> 10,
+           (unsigned long long)stats.capacity >> 10,
+           (unsigned long long)stats.peak >> 10,
+           (unsigned long long)(stats.allocs - _arenas[i].dumped_allocs));
+
+    _arenas[i].dumped_allocs = stats.allocs;
+  }
+
+  printf("\n");
+}
+
+U32 arena::sites(ArenaHandle handle, ArenaSite* sites, U32 max_sites) {
+  U32 count = 0;
+
+#ifdef ARENA_TRACK_SITES
+  std::lock_guard lock(_sites_lock);
+
+  for (U32 i = 0; i < MAX_SITES; ++i) {
+    if (_sites[i].site.file == nullptr || _sites[i].handle != handle) continue;
+
+    // insertion into the sorted top max_sites
+    U32 at = count < max_sites ? count++ : max_sites;
+
+    while (at > 0 && sites[at - 1].bytes < _sites[i].site.bytes) {
+      if (at < max_sites) sites[at] = sites[at - 1];
+      --at;
+    }
+
+    if (at < max_sites) sites[at] = _sites[i].site;
+  }
+#endif
+
+  return count;
 }
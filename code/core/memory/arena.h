@@ -6,50 +6,188 @@
 #include <cstddef>
 #include <cstdint>
 #include <cstdio>
+#include <source_location>
 #include <sys/types.h>
 
 #define ARENA_INIT(NAME, SIZE)                                                                     \
   U8          memory_##NAME##_##__LINE__[SIZE];                                                    \
   ArenaHandle a_##NAME##_##__LINE__ = arena::set(#NAME, memory_##NAME##_##__LINE__, SIZE);
 
+// an arena over SIZE bytes of address space, pages are committed as it grows
+#define ARENA_RESERVE(NAME, SIZE)                                                                  \
+  ArenaHandle a_##NAME##_##__LINE__ = arena::reserve(#NAME, SIZE);
+
+#define ARENA_RESERVE_HUGE(NAME, SIZE)                                                             \
+  ArenaHandle a_##NAME##_##__LINE__ = arena::reserve(#NAME, SIZE, true);
+
 struct Arena {
   U8*       buf;
-  U32       buf_len;
+  U64       buf_len;
+  U64       reserved;
   uintptr_t prev_offset;
   uintptr_t curr_offset;
 };
 
+// where an arena was at one point, restoring it frees everything allocated
+// after that
+struct ArenaMark {
+  ArenaHandle handle;
+  uintptr_t   prev_offset;
+  uintptr_t   curr_offset;
+};
+
+struct ArenaStats {
+  const char* name;
+  U64         used;
+  U64         peak;
+  U64         capacity;
+  U64         allocs;
+  U64         bytes;
+  U64         wasted;
+};
+
+// allocations made from one line of code, counted in debug builds
+struct ArenaSite {
+  const char* file;
+  U32         line;
+  U64         allocs;
+  U64         bytes;
+};
+
 namespace arena {
   const U8 DEFAULT_ALIGNMENT = 8;
 
+  // sizes of the scratch and frame arenas a thread gets after init_thread.
+  // they are carved out of the "threads" arena the first time the thread
+  // asks for them
+  const U32 THREAD_SCRATCH_SIZE = 1 << 20;
+  const U32 THREAD_FRAME_SIZE   = 1 << 16;
+
+  // commit granularity of reserved arenas, with and without huge pages
+  const U32 COMMIT_SIZE      = 1 << 16;
+  const U32 HUGE_COMMIT_SIZE = 1 << 21;
+
   ArenaHandle set(const char* name, U8* mem, U32 mem_size);
+
+  // reserves size bytes of address space without backing it. alloc commits
+  // pages as the arena grows, so it never moves and untouched parts cost no
+  // memory. huge_pages asks for transparent huge pages, worth it for big
+  // arenas that are walked a lot like level
+  ArenaHandle reserve(const char* name, U64 size, bool huge_pages = false);
   void        set_scratch(U8* mem, U32 size);
 
-  ArenaHandle        by_name(const char* name);
-  inline ArenaHandle scratch() { return ArenaHandle{.value = 0}; };
+  // looking up and registering arenas is safe from any thread. allocating
+  // is not, unless the arena is shared
+  ArenaHandle by_name(const char* name);
+
+  // makes alloc on the arena a lock free atomic bump, for arenas that more
+  // than one thread allocates from at the same time. resize never grows a
+  // shared arena's last allocation in place
+  void share(ArenaHandle handle);
 
+  // gives the calling thread scratch and frame arenas of its own. threads
+  // that never call it, like the main thread, use the global ones
+  void init_thread();
+
+  ArenaHandle scratch();
   ArenaHandle frame();
   void        set_frame(U8 arena_index);
 
-  U8*  alloc(ArenaHandle handle, U32 size, U8 align = DEFAULT_ALIGNMENT);
-  U8*  resize(ArenaHandle handle,
-              U8*         old_memory,
-              U32         old_size,
-              U32         new_size,
-              U8          align = DEFAULT_ALIGNMENT);
+  // allocations are zeroed, alloc_uninit leaves that to callers that write
+  // every byte anyway. site is only there for the telemetry
+  U8*  alloc(ArenaHandle          handle,
+             U32                  size,
+             U8                   align = DEFAULT_ALIGNMENT,
+             std::source_location site  = std::source_location::current());
+  U8*  alloc_uninit(ArenaHandle          handle,
+                    U32                  size,
+                    U8                   align = DEFAULT_ALIGNMENT,
+                    std::source_location site  = std::source_location::current());
+  U8*  resize(ArenaHandle          handle,
+              U8*                  old_memory,
+              U32                  old_size,
+              U32                  new_size,
+              U8                   align = DEFAULT_ALIGNMENT,
+              std::source_location site  = std::source_location::current());
   void reset(ArenaHandle handle);
 
+  // marks nest, a mark has to be restored before the ones taken ahead of
+  // it. not for shared arenas. debug builds overwrite freed memory with
+  // POISON so reads through stale pointers show
+  const U8 POISON = 0xdd;
+
+  ArenaMark mark(ArenaHandle handle);
+  void      restore(ArenaMark mark);
+
+  // dump and stats report the arena's peak as of the last reset, restore
+  // or query, and how much of it is full
+  const F32 FULL_WARNING = 0.8f;
+
+  ArenaStats stats(ArenaHandle handle);
+
+  // one line with every arena that is set up: usage, peak, capacity and the
+  // allocs since the last dump. meant to be called once a frame, arenas past
+  // FULL_WARNING are marked with '!'
+  void dump();
+
+  // writes the arena's call sites with the most bytes to sites, most first,
+  // and returns how many there were. counting them serializes allocs on a
+  // lock, it is only done in builds with ARENA_TRACK_SITES, always 0 in
+  // the others
+  U32 sites(ArenaHandle handle, ArenaSite* sites, U32 max_sites);
+
+  template <typename T>
+  T* alloc(ArenaHandle          handle,
+           U32                  size,
+           U8                   align = DEFAULT_ALIGNMENT,
+           std::source_location site  = std::source_location::current()) {
+    return reinterpret_cast<T*>(alloc(handle, size, align, site));
+  }
+
   template <typename T>
-  T* alloc(ArenaHandle handle, U32 size, U8 align = DEFAULT_ALIGNMENT) {
-    return reinterpret_cast<T*>(alloc(handle, size, align));
+  T* alloc_uninit(ArenaHandle          handle,
+                  U32                  size,
+                  U8                   align = DEFAULT_ALIGNMENT,
+                  std::source_location site  = std::source_location::current()) {
+    return reinterpret_cast<T*>(alloc_uninit(handle, size, align, site));
   }
 
+  // count values of T, each set to value in a single pass
   template <typename T>
-  T resize(ArenaHandle handle,
-           U8*         old_memory,
-           U32         old_size,
-           U32         new_size,
-           U8          align = DEFAULT_ALIGNMENT) {
-    return reinterpret_cast<T>(resize(handle, old_memory, old_size, new_size, align));
+  T* alloc_fill(ArenaHandle          handle,
+                U32                  count,
+                const T&             value,
+                U8                   align = DEFAULT_ALIGNMENT,
+                std::source_location site  = std::source_location::current()) {
+    T* data = alloc_uninit<T>(handle, count * sizeof(T), align, site);
+
+    for (U32 i = 0; i < count; ++i) {
+      data[i] = value;
+    }
+
+    return data;
+  }
+
+  template <typename T>
+  T resize(ArenaHandle          handle,
+           U8*                  old_memory,
+           U32                  old_size,
+           U32                  new_size,
+           U8                   align = DEFAULT_ALIGNMENT,
+           std::source_location site  = std::source_location::current()) {
+    return reinterpret_cast<T>(resize(handle, old_memory, old_size, new_size, align, site));
   }
 }
+
+// frees what the scope allocated from the arena when it ends, so temporary
+// work can use scratch at any depth without growing it
+struct TempArena {
+  ArenaHandle handle;
+  ArenaMark   mark;
+
+  explicit TempArena(ArenaHandle handle) : handle(handle), mark(arena::mark(handle)) {}
+  ~TempArena() { arena::restore(mark); }
+
+  TempArena(const TempArena&)            = delete;
+  TempArena& operator=(const TempArena&) = delete;
+};
@@ -0,0 +1,226 @@
+#pragma once
+
+#include "arena.h"
+#include "handles.h"
+#include "types.h"
+
+#include <atomic>
+#include <cassert>
+#include <cstdio>
+#include <cstring>
+
+// fixed size slots for objects that come and go one at a time. a free slot
+// holds the next free one, so alloc and free are a pointer swap. slots are
+// carved from the arena once, freeing never returns memory to it
+struct PoolStats {
+  U32 live;
+  U32 peak;
+  U64 allocs;
+  U64 frees;
+  U32 refills;
+  U32 flushes;
+};
+
+template <typename T>
+struct Pool {
+  static constexpr U32 SLOT_ALIGN = alignof(T) > alignof(U8*) ? alignof(T) : alignof(U8*);
+  static constexpr U32 SLOT_SIZE =
+      (U32(sizeof(T) > sizeof(U8*) ? sizeof(T) : sizeof(U8*)) + SLOT_ALIGN - 1) / SLOT_ALIGN *
+      SLOT_ALIGN;
+
+  U8*       _data;
+  U32       _capacity;
+  U32       _carved;
+  U8*       _free;
+  U32       _lock;
+  PoolStats _stats;
+};
+
+// a thread's own stack of free slots. alloc and free through a cache touch
+// the pool only to refill or flush half of it, under the pool's lock. the
+// stats count slots handed to caches as live
+const U32 POOL_CACHE_SIZE = 32;
+
+template <typename T>
+struct PoolCache {
+  T*  slots[POOL_CACHE_SIZE];
+  U32 count;
+};
+
+namespace pool {
+  template <typename T>
+  Pool<T> init(ArenaHandle arena_handle, U32 capacity);
+
+  // the slot's contents are left as they were, callers assign the value.
+  // only for pools that a single thread uses
+  template <typename T>
+  T* alloc(Pool<T>& pool);
+  template <typename T>
+  void free(Pool<T>& pool, T* value);
+
+  // safe to use from several threads as long as each has its own cache.
+  // flush returns everything the cache holds, before it is dropped
+  template <typename T>
+  T* alloc(Pool<T>& pool, PoolCache<T>& cache);
+  template <typename T>
+  void free(Pool<T>& pool, PoolCache<T>& cache, T* value);
+  template <typename T>
+  void flush(Pool<T>& pool, PoolCache<T>& cache);
+
+  // slots have stable indices, for handles that store one
+  template <typename T>
+  U32 index(const Pool<T>& pool, const T* value);
+  template <typename T>
+  T* at(Pool<T>& pool, U32 index);
+
+  // frees every slot at once, caches must not hold any
+  template <typename T>
+  void clear(Pool<T>& pool);
+}
+
+// implementation
+namespace pool {
+  inline U8*& _next(U8* slot) { return *reinterpret_cast<U8**>(slot); }
+
+  template <typename T>
+  bool _full(const Pool<T>& pool) {
+    return pool._free == nullptr && pool._carved == pool._capacity;
+  }
+
+  template <typename T>
+  void _lock(Pool<T>& pool) {
+    std::atomic_ref<U32> lock(pool._lock);
+
+    while (lock.exchange(1, std::memory_order_acquire) != 0) {
+      while (lock.load(std::memory_order_relaxed) != 0) {
+      }
+    }
+  }
+
+  template <typename T>
+  void _unlock(Pool<T>& pool) {
+    std::atomic_ref<U32>(pool._lock).store(0, std::memory_order_release);
+  }
+
+  template <typename T>
+  Pool<T> init(ArenaHandle arena_handle, U32 capacity) {
+    return Pool<T>{
+        ._data =
+            arena::alloc_uninit(arena_handle, capacity * Pool<T>::SLOT_SIZE, Pool<T>::SLOT_ALIGN),
+        ._capacity = capacity,
+        ._carved   = 0,
+        ._free     = nullptr,
+        ._lock     = 0,
+        ._stats    = {},
+    };
+  }
+
+  template <typename T>
+  T* alloc(Pool<T>& pool) {
+    U8* slot = pool._free;
+
+    if (slot) {
+      pool._free = _next(slot);
+    } else if (pool._carved < pool._capacity) {
+      slot = pool._data + pool._carved++ * Pool<T>::SLOT_SIZE;
+    } else {
+      printf("pool of %u slots is full\n", pool._capacity);
+      assert(false);
+      return nullptr;
+    }
+
+    ++pool._stats.allocs;
+    if (++pool._stats.live > pool._stats.peak) pool._stats.peak = pool._stats.live;
+
+    return reinterpret_cast<T*>(slot);
+  }
+
+  template <typename T>
+  void free(Pool<T>& pool, T* value) {
+    U8* slot = reinterpret_cast<U8*>(value);
+
+    assert(slot >= pool._data && slot < pool._data + pool._carved * Pool<T>::SLOT_SIZE &&
+           "value is not from this pool");
+
+#ifndef NDEBUG
+    memset(slot, arena::POISON, Pool<T>::SLOT_SIZE);
+#endif
+
+    _next(slot) = pool._free;
+    pool._free  = slot;
+
+    ++pool._stats.frees;
+    --pool._stats.live;
+  }
+
+  template <typename T>
+  T* alloc(Pool<T>& pool, PoolCache<T>& cache) {
+    if (cache.count == 0) {
+      _lock(pool);
+
+      // a nearly full pool refills what it has left
+      for (U32 i = 0; i < POOL_CACHE_SIZE / 2 && !_full(pool); ++i) {
+        cache.slots[cache.count++] = alloc(pool);
+      }
+      ++pool._stats.refills;
+
+      _unlock(pool);
+
+      if (cache.count == 0) {
+        printf("pool of %u slots is full\n", pool._capacity);
+        assert(false);
+        return nullptr;
+      }
+    }
+
+    return cache.slots[--cache.count];
+  }
+
+  template <typename T>
+  void free(Pool<T>& pool, PoolCache<T>& cache, T* value) {
+    if (cache.count == POOL_CACHE_SIZE) {
+      _lock(pool);
+
+      for (U32 i = 0; i < POOL_CACHE_SIZE / 2; ++i) {
+        free(pool, cache.slots[--cache.count]);
+      }
+      ++pool._stats.flushes;
+
+      _unlock(pool);
+    }
+
+    cache.slots[cache.count++] = value;
+  }
+
+  template <typename T>
+  void flush(Pool<T>& pool, PoolCache<T>& cache) {
+    _lock(pool);
+
+    while (cache.count > 0) {
+      free(pool, cache.slots[--cache.count]);
+    }
+    ++pool._stats.flushes;
+
+    _unlock(pool);
+  }
+
+  template <typename T>
+  U32 index(const Pool<T>& pool, const T* value) {
+    return static_cast<U32>((reinterpret_cast<const U8*>(value) - pool._data) / Pool<T>::SLOT_SIZE);
+  }
+
+  template <typename T>
+  T* at(Pool<T>& pool, U32 index) {
+    assert(index < pool._carved && "slot was never allocated");
+
+    return reinterpret_cast<T*>(pool._data + index * Pool<T>::SLOT_SIZE);
+  }
+
+  template <typename T>
+  void clear(Pool<T>& pool) {
+    pool._carved      = 0;
+    pool._free        = nullptr;
+    pool._stats.frees += pool._stats.live;
+    pool._stats.live  = 0;
+  }
+}
@@ -1,5 +1,6 @@
 #include "engine.h"
 
+#include "arena.h"
 #include "render.h"
 #include "types.h"
 
@@ -17,6 +18,7 @@ namespace {
   U64           current_time  = 0;
   U64           frame_count   = 0;
   U64           fps_last_time;
+  bool          dump_arenas = false;
 
   SDL_Window* sdl_window;
 }
@@ -78,6 +80,10 @@ void engine::begin_frame() {
         if (event.key.key == SDLK_ESCAPE) {
           state.quit = true;
         }
+        // F3 prints arena usage once a frame
+        if (event.key.key == SDLK_F3) {
+          dump_arenas = !dump_arenas;
+        }
         break;
 
       // case SDL_EVENT_KEY_UP:
@@ -123,6 +129,8 @@ void engine::begin_frame() {
 void engine::end_frame() {
   render::end_frame();
 
+  if (dump_arenas) arena::dump();
+
   if ((current_time - fps_last_time) > SDL_GetPerformanceFrequency()) {
     state.fps = frame_count /
                 (static_cast<F64>(current_time - fps_last_time) / SDL_GetPerformanceFrequency());
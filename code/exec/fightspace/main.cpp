@@ -2,6 +2,7 @@
 #include "ds_array_dynamic.h"
 #include "ds_string.h"
 #include "engine.h"
+#include "jobs.h"
 #include "exec/fightspace/simulation.h"
 #include "exec/fightspace/ui.h"
 #include "render.h"
@@ -11,11 +12,12 @@
 #include "vulkan/ubos.h"
 
 ARENA_INIT(scratch, 10000000);
-ARENA_INIT(render, 100000000);
+ARENA_RESERVE(render, 1ull << 32);
 ARENA_INIT(frame0, 100000);
 ARENA_INIT(frame1, 100000);
 ARENA_INIT(frame2, 100000);
-ARENA_INIT(level, 100000000);
+ARENA_RESERVE_HUGE(level, 1ull << 36);
+ARENA_RESERVE(threads, 1ull << 32);
 
 int main() {
   auto state = engine::init({
@@ -54,6 +56,8 @@ int main() {
       .ubos = S_DARRAY(vulkan::UBOHandle, texture_set_ubo, material_ssbo_ubo),
   });
 
+  jobs::init();
+
   simulation::init(0, 0, 1024, 1024, vulkan::ubos::mapped(material_ssbo_ubo));
 
   ui::set_builder(fightspace_ui);
@@ -62,7 +66,7 @@ int main() {
     engine::begin_frame();
     render::bind_pipeline(render_pipeline);
 
-    simulation::simulate();
+    simulation::advance(state->dt);
 
     render::draw();
 
@@ -74,6 +78,8 @@ int main() {
 
   vulkan::ubos::cleanup(texture_set_ubo);
 
+  jobs::cleanup();
+
   engine::cleanup();
 
   return 0;
@@ -0,0 +1,248 @@
+#include "arena.h"
+#include "exec/fightspace/simulation.h"
+#include "exec/fightspace/simulation_replay.h"
+#include "jobs.h"
+#include "lifetimes.h"
+#include "types.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+ARENA_RESERVE_HUGE(level, 1ull << 36);
+ARENA_INIT(replay, 10000000);
+
+// runs the simulation without a window or a gpu. the material buffer is
+// plain host memory, so what is measured is simulate and the copy into it.
+// ns/cell is per cell of the chunks a tick updated
+//
+//   sim_bench [ticks] [threads]
+//   sim_bench --record <file> [ticks]   records the sand rain scenario
+//   sim_bench --replay <file> [threads] plays a recording at full speed
+namespace {
+  const U32 LEVEL_WIDTH  = 1024;
+  const U32 LEVEL_HEIGHT = 1024;
+  const U32 CHUNK_CELLS  = 64 * 64;
+
+  U8 _view_memory[192 * 108];
+
+  void _fill(U32 min_x, U32 min_y, U32 max_x, U32 max_y, MaterialType type) {
+    for (U32 y = min_y; y <= max_y; ++y) {
+      for (U32 x = min_x; x <= max_x; ++x) {
+        simulation::add_cell(x, y, type);
+      }
+    }
+  }
+
+  void _settle() {
+    for (U32 i = 0; i < LEVEL_HEIGHT * 2; ++i) {
+      simulation::simulate();
+
+      if (simulation::stats().chunks_awake == 0) return;
+    }
+  }
+
+  // a row of sand every other column along the top, refilled every tick
+  void _sand_rain_tick(U32 tick) {
+    for (U32 x = tick % 2; x < LEVEL_WIDTH; x += 2) {
+      simulation::add_cell(x, 0, MaterialType::SAND);
+    }
+  }
+
+  void _sand_rain_setup() {}
+
+  // a tank of water in the upper half of the level, emptied into the lower
+  // half at once
+  void _water_tank_setup() {
+    _fill(0, 0, LEVEL_WIDTH / 2 - 1, LEVEL_HEIGHT / 2 - 1, MaterialType::WATER);
+  }
+
+  // settled stone and sand with a trickle of sand in one chunk
+  void _static_world_setup() {
+    _fill(0,
+          LEVEL_HEIGHT - 256,
+          LEVEL_WIDTH - 1,
+          LEVEL_HEIGHT - 129,
+          MaterialType::STONE);
+    _fill(0,
+          LEVEL_HEIGHT - 128,
+          LEVEL_WIDTH - 1,
+          LEVEL_HEIGHT - 1,
+          MaterialType::SAND);
+    _settle();
+  }
+
+  void _static_world_tick(U32) {
+    simulation::add_cell(LEVEL_WIDTH / 2, 0, MaterialType::SAND);
+  }
+
+  // a settled sand pile with a 200 cell wide hole blown into its base,
+  // everything above the hole falls at once
+  void _explosion_setup() {
+    _fill(0,
+          LEVEL_HEIGHT / 2,
+          LEVEL_WIDTH - 1,
+          LEVEL_HEIGHT - 1,
+          MaterialType::SAND);
+    _settle();
+
+    I32 center_x = LEVEL_WIDTH / 2;
+    I32 center_y = LEVEL_HEIGHT - 120;
+    I32 radius   = 100;
+
+    for (I32 y = -radius; y <= radius; ++y) {
+      for (I32 x = -radius; x <= radius; ++x) {
+        if (x * x + y * y > radius * radius) continue;
+
+        simulation::add_cell(center_x + x, center_y + y, MaterialType::AIR);
+      }
+    }
+  }
+
+  struct Scenario {
+    const char* name;
+    void (*setup)();
+    void (*tick)(U32 tick);
+  };
+
+  const Scenario SCENARIOS[] = {
+      {"sand rain", _sand_rain_setup, _sand_rain_tick},
+      {"water tank", _water_tank_setup, nullptr},
+      {"static world", _static_world_setup, _static_world_tick},
+      {"explosion", _explosion_setup, nullptr},
+  };
+
+  int _record(const char* path, U32 ticks) {
+    lifetime::release(LifeTime::LEVEL);
+    simulation::init(0, 0, LEVEL_WIDTH, LEVEL_HEIGHT, nullptr);
+    if (!simulation::replay::start(arena::by_name("replay"),
+                                   LEVEL_WIDTH,
+                                   LEVEL_HEIGHT)) {
+      return 1;
+    }
+
+    for (U32 tick = 0; tick < ticks; ++tick) {
+      _sand_rain_tick(tick);
+      simulation::simulate();
+    }
+
+    simulation::replay::stop();
+
+    if (!simulation::replay::save(path)) return 1;
+
+    printf("recorded %u ticks, %u bytes, state hash %016llx\n",
+           ticks,
+           simulation::replay::data()._size,
+           (unsigned long long)simulation::state_hash());
+
+    return 0;
+  }
+
+  int _replay(const char* path) {
+    auto recording = simulation::replay::load(arena::by_name("replay"), path);
+
+    if (recording._size == 0) return 1;
+
+    lifetime::release(LifeTime::LEVEL);
+
+    auto started = std::chrono::steady_clock::now();
+    U32  ticks   = simulation::replay::play(recording, nullptr);
+    auto elapsed = std::chrono::duration<F64>(
+                       std::chrono::steady_clock::now() - started)
+                       .count();
+
+    if (ticks == 0) return 1;
+
+    printf("replayed %u ticks in %.3f s, %.0f ticks/s, state hash %016llx\n",
+           ticks,
+           elapsed,
+           ticks / elapsed,
+           (unsigned long long)simulation::state_hash());
+
+    return 0;
+  }
+
+  void _run(const Scenario& scenario, U32 ticks) {
+    lifetime::release(LifeTime::LEVEL);
+    simulation::init(0, 0, LEVEL_WIDTH, LEVEL_HEIGHT, _view_memory);
+
+    scenario.setup();
+
+    std::vector<U64> tick_ns(ticks);
+    U64              total_ns      = 0;
+    U64              cells_updated = 0;
+    U64              chunks_awake  = 0;
+
+    for (U32 tick = 0; tick < ticks; ++tick) {
+      if (scenario.tick) scenario.tick(tick);
+
+      auto started = std::chrono::steady_clock::now();
+
+      simulation::simulate();
+
+      tick_ns[tick] = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                          std::chrono::steady_clock::now() - started)
+                          .count();
+
+      total_ns      += tick_ns[tick];
+      cells_updated += simulation::stats().chunks_updated * CHUNK_CELLS;
+      chunks_awake  += simulation::stats().chunks_awake;
+    }
+
+    std::sort(tick_ns.begin(), tick_ns.end());
+
+    printf("%-14s %8.3f %8.3f %10.2f %10.1f\n",
+           scenario.name,
+           tick_ns[ticks / 2] / 1e6,
+           tick_ns[std::min(ticks - 1, ticks * 99 / 100)] / 1e6,
+           cells_updated ? double(total_ns) / cells_updated : 0.0,
+           double(chunks_awake) / ticks);
+  }
+}
+
+int main(int argc, char** argv) {
+  if (argc > 2 && strcmp(argv[1], "--record") == 0) {
+    jobs::init();
+    int result = _record(argv[2], argc > 3 ? atoi(argv[3]) : 600);
+    jobs::cleanup();
+
+    return result;
+  }
+
+  if (argc > 2 && strcmp(argv[1], "--replay") == 0) {
+    jobs::init(argc > 3 ? atoi(argv[3]) : 0);
+    int result = _replay(argv[2]);
+    jobs::cleanup();
+
+    return result;
+  }
+
+  U32 ticks        = argc > 1 ? atoi(argv[1]) : 600;
+  U32 thread_count = argc > 2 ? atoi(argv[2]) : 0;
+
+  if (ticks == 0) {
+    printf("usage: sim_bench [ticks] [threads]\n");
+    return 1;
+  }
+
+  jobs::init(thread_count);
+
+  printf("%u ticks on a %ux%u level\n", ticks, LEVEL_WIDTH, LEVEL_HEIGHT);
+  printf("%-14s %8s %8s %10s %10s\n",
+         "scenario",
+         "p50 ms",
+         "p99 ms",
+         "ns/cell",
+         "awake");
+
+  for (auto& scenario : SCENARIOS) {
+    _run(scenario, ticks);
+  }
+
+  jobs::cleanup();
+
+  return 0;
+}
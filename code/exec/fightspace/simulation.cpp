@@ -1,23 +1,58 @@
 #include "simulation.h"
 
 #include "arena.h"
-#include "ds_dynamic_sparse_array.h"
-#include "ds_sparse_array.h"
+#include "ds_array_dynamic.h"
+#include "ds_hashmap.h"
+#include "fnv-1a/fnv.h"
+#include "jobs.h"
+#include "lifetimes.h"
+#include "simulation_cells.h"
+#include "simulation_checkpoints.h"
+#include "simulation_heat.h"
+#include "simulation_kernels.h"
+#include "simulation_materials.h"
+#include "simulation_pages.h"
+#include "simulation_particles.h"
+#include "simulation_random.h"
+#include "simulation_replay.h"
+#include "simulation_rle.h"
+#include "simulation_solids.h"
 #include "types.h"
 
+#include <algorithm>
+#include <bit>
+#include <chrono>
+#include <cmath>
+#include <utility>
+
 namespace {
-  auto mem_level = arena::by_name("level");
+  using simulation::cells::Cell;
+
+  auto mem_level = lifetime::arena(LifeTime::LEVEL);
 
   const U8  CHUNK_WIDTH        = 64;
   const U8  CHUNK_HEIGHT       = 64;
   const U16 CHUNK_WIDTH_HEIGHT = CHUNK_WIDTH * CHUNK_HEIGHT;
 
+  static_assert(CHUNK_WIDTH == simulation::kernels::ROW_WIDTH,
+                "Row kernels work on whole chunk rows");
+
   const U8 VIEW_WIDTH  = 192;
   const U8 VIEW_HEIGHT = 108;
 
   const U8 GHOST_BORDER_WIDTH = 3;
 
-  const U16 MAX_CHUNKS = U16_MAX;
+  // a chunk's halo holds copies of the neighbour cells up to
+  // GHOST_BORDER_WIDTH outside its edges. the top and bottom bands span the
+  // corners too, the left and right bands only the chunk's own rows
+  const U8  HALO_ROW_WIDTH = CHUNK_WIDTH + 2 * GHOST_BORDER_WIDTH;
+  const U16 HALO_BAND_SIZE = GHOST_BORDER_WIDTH * HALO_ROW_WIDTH;
+  const U16 HALO_SIZE =
+      2 * HALO_BAND_SIZE + 2 * CHUNK_HEIGHT * GHOST_BORDER_WIDTH;
+
+  // the chunk directory hashes pages of PAGE_WIDTH x PAGE_WIDTH chunk
+  // pointers by their page coordinates
+  const U32 PAGE_WIDTH = 16;
 
   enum class BorderChange : U8 {
     NONE         = 0,
@@ -31,254 +66,2298 @@ namespace {
     BOTTOM_RIGHT = 1 << 7,
   };
 
+  BorderChange operator|(BorderChange lhs, BorderChange rhs) {
+    return static_cast<BorderChange>(std::to_underlying(lhs) |
+                                     std::to_underlying(rhs));
+  }
+
+  bool operator&(BorderChange lhs, BorderChange rhs) {
+    return (std::to_underlying(lhs) & std::to_underlying(rhs)) != 0;
+  }
+
+  struct Neighbour {
+    I8           dx;
+    I8           dy;
+    BorderChange border;
+  };
+
+  const Neighbour NEIGHBOURS[] = {
+      {0, -1, BorderChange::TOP},
+      {0, 1, BorderChange::BOTTOM},
+      {-1, 0, BorderChange::LEFT},
+      {1, 0, BorderChange::RIGHT},
+      {-1, -1, BorderChange::TOP_LEFT},
+      {1, -1, BorderChange::TOP_RIGHT},
+      {-1, 1, BorderChange::BOTTOM_LEFT},
+      {1, 1, BorderChange::BOTTOM_RIGHT},
+  };
+
+  // inclusive cell bounds inside a chunk, empty when min_x > max_x
+  struct DirtyRect {
+    U8 min_x = U8_MAX;
+    U8 min_y = U8_MAX;
+    U8 max_x = 0;
+    U8 max_y = 0;
+  };
+
+  const DirtyRect FULL_RECT = {
+      .min_x = 0,
+      .min_y = 0,
+      .max_x = CHUNK_WIDTH - 1,
+      .max_y = CHUNK_HEIGHT - 1,
+  };
+
   U32 _view_x         = 0;
   U32 _view_y         = 0;
   U32 _chunks_x_count = 0;
   U32 _chunks_y_count = 0;
-  U32 _chunks_count   = 0;
 
-  U8* _gpu_memory = nullptr;
+  U8*  _gpu_memory     = nullptr;
+  bool _gpu_view_moved = false;
+
+  // sleeping chunks are run length coded once they slept this many ticks
+  const U32 DORMANT_TICKS = 60;
+
+  // where a chunk's cells are. STORING and LOADING chunks hold a block that
+  // the page thread is still writing out or reading into. COMPRESSED chunks
+  // have no block, their cells are in packed
+  enum class Residency : U8 {
+    RESIDENT,
+    STORING,
+    STORED,
+    LOADING,
+    COMPRESSED,
+  };
 
   struct Chunk {
-    U8 x;
-    U8 y;
+    U32 x;
+    U32 y;
+
+    // position in _chunks, which is how checkpoints know the chunk
+    U32 index;
+
+    // listed in _awake, so the next simulate updates it
+    bool awake = false;
+
+    // a tick reads cells[front] and writes cells[front ^ 1], so
+    // chunks can be updated in any order and on any thread
+    U8 front = 0;
 
+    // neighbours whose halo overlaps cells changed by the running tick. the
+    // chunk pushes its border band into those halos once the tick is done
     BorderChange border_changes = BorderChange::NONE;
 
-    StaticArray<MaterialType, CHUNK_WIDTH * CHUNK_HEIGHT> materials[2];
-    StaticArray<U8, CHUNK_WIDTH * CHUNK_HEIGHT>           velocity_x[2];
-    StaticArray<U8, CHUNK_WIDTH * CHUNK_HEIGHT>           velocity_y[2];
-    StaticArray<U8, CHUNK_WIDTH * CHUNK_HEIGHT>           flags[2];
+    // cells changed by the running tick, and the cells the next tick has to
+    // look at. a chunk with nothing to look at goes to sleep
+    DirtyRect dirty;
+    DirtyRect active;
+
+    // cells that did not change but might on the next tick, like a burning
+    // neighbour of wood. they keep the chunk awake
+    DirtyRect busy;
+
+    // cells changed since they were last copied to the gpu
+    DirtyRect gpu_dirty;
+
+    // cells given a velocity since the last tick, launched by the next one
+    DirtyRect pushed;
+
+    // two heat fields, _heat_front picks the one a tick reads. nullptr
+    // while the chunk and its neighbours are cold
+    F32* heat = nullptr;
+
+    // set by the heat pass: the hottest heat cell, the sides the field is
+    // warm at and the cells hot enough to catch fire
+    F32          hottest    = 0.0f;
+    BorderChange heat_edges = BorderChange::NONE;
+    DirtyRect    ignites;
+
+    // a bit per material that may be in the chunk. the running tick ors the
+    // materials it writes into materials_seen, neighbours read materials
+    U16 materials      = simulation::materials::bit(MaterialType::AIR);
+    U16 materials_seen = 0;
+
+    // hash of position and front cells for state_hash, valid while hashed
+    U64  hash   = 0;
+    bool hashed = false;
+
+    StaticArray<Cell, CHUNK_WIDTH_HEIGHT> cells[2];
+#ifndef SIMULATION_PACKED_CELLS
+    StaticArray<U8, CHUNK_WIDTH_HEIGHT> velocity_x[2];
+    StaticArray<U8, CHUNK_WIDTH_HEIGHT> velocity_y[2];
+    StaticArray<U8, CHUNK_WIDTH_HEIGHT> flags[2];
+#endif
+
+    // neighbour cells as of the start of the running tick, BORDER outside
+    // the level
+    StaticArray<Cell, HALO_SIZE> halo;
+
+    // the buffers above all point into one block of chunk_bytes(), which is
+    // also the chunk's record in the page file
+    U8*       block       = nullptr;
+    Residency residency   = Residency::RESIDENT;
+    bool      prefetched  = false;
+    U32       page_record = U32_MAX;
+    U64       io_ticket   = 0;
+
+    // tick the chunk last went to sleep on
+    U32 slept_at = 0;
+
+    // run length coded front buffer, planes and halo of a dormant chunk.
+    // kept when the chunk wakes, so compressing it again usually reuses it
+    U8* packed          = nullptr;
+    U32 packed_bytes    = 0;
+    U32 packed_capacity = 0;
+
+    // the chunk's solid cells as of the last label pass, nullptr until the
+    // chunk first held any, and the cells changed since. chunks with
+    // reshaped cells are listed in _reshaped
+    simulation::solids::Solids* solids = nullptr;
+    DirtyRect                   reshaped;
   };
 
-  StaticSparseArray16<Chunk, MAX_CHUNKS, MAX_CHUNKS> alive;
-  StaticSparseArray16<Chunk, MAX_CHUNKS, MAX_CHUNKS> dead;
+  // the start of a chunk's checkpoint record, the cells and planes of its
+  // front buffer follow
+  struct RecordHead {
+    DirtyRect active;
+    U16       materials;
+  };
 
-  U8 current_buffer_index = 0;
+  struct ChunkPage {
+    Chunk* chunks[PAGE_WIDTH * PAGE_WIDTH];
+  };
 
-  Chunk* _get_chunk(U32 chunk_x, U32 chunk_y) {
+  // chunks and their pages are allocated the first time something touches
+  // them, so level memory grows with the touched area. a chunk that was
+  // never allocated is all AIR
+  HashMap64<ChunkPage*> _pages;
+  DynamicArray<Chunk*>  _awake;
+
+  // every chunk, in the order they were allocated
+  DynamicArray<Chunk*> _chunks;
+
+  // chunks holding a block, and blocks given back by evicted chunks
+  DynamicArray<Chunk*> _resident;
+  DynamicArray<U8*>    _free_blocks;
+
+  // with streaming on, chunks further than _residency_radius +
+  // _prefetch_ring chunks from the view are written to the page file once
+  // they sleep. the ring is read back in the background as the view
+  // approaches, the radius is read back right away
+  bool _streaming        = false;
+  U32  _residency_radius = 0;
+  U32  _prefetch_ring    = 0;
+  U32  _page_records     = 0;
+
+  // chunk rect the last residency pass loaded, inclusive
+  U32 _residency_rect[4] = {U32_MAX, U32_MAX, 0, 0};
+
+  // ticks simulated since init, and the fixed tick advance runs
+  U32 _tick         = 0;
+  F64 _tick_seconds = 1.0 / 60.0;
+  F64 _accumulator  = 0.0;
+
+  // advance drops time it is behind by more than this many ticks, rather
+  // than spending every frame catching up
+  const U32 MAX_TICKS_PER_ADVANCE = 4;
+
+  // holds a chunk while it is compressed, rle::max_bytes of everything
+  U8* _packing = nullptr;
+
+  // chunks with a heat field, and fields of chunks that cooled off
+  DynamicArray<Chunk*> _hot;
+  DynamicArray<F32*>   _free_heat;
+  U8                   _heat_front = 0;
+
+  // material in free flight, and the chunks with pushed cells
+  const U32 MAX_PARTICLES = 1 << 17;
+
+  simulation::particles::Pool _particles;
+  DynamicArray<Chunk*>        _pushed;
+
+  // a cell velocity of 1 is a quarter cell per tick
+  const F32 CELL_VELOCITY = 0.25f;
+
+  // particles are flown in blocks of this many on the job threads
+  const U32 PARTICLE_BLOCK = 4096;
+
+  enum class Flight : U8 {
+    FLYING,
+    LANDED,
+    // crossed a chunk that is not resident, flown again on the main thread
+    PENDING,
+  };
+
+  Flight* _flights = nullptr;
+
+  // the chunks whose solid cells may have changed since the last label
+  // pass, and the solids of those the pass relabeled
+  DynamicArray<Chunk*>                      _reshaped;
+  DynamicArray<simulation::solids::Solids*> _relabeled;
+
+  bool _parallel = true;
+
+  simulation::Kernel _kernel = simulation::kernels::best();
+
+  simulation::kernels::FallRowFn _fall_row =
+      simulation::kernels::fall_row(_kernel);
+
+  simulation::Stats _stats;
+
+  U64 _page_key(U32 chunk_x, U32 chunk_y) {
+    return (U64(chunk_y / PAGE_WIDTH) << 32) | (chunk_x / PAGE_WIDTH);
+  }
+
+  Chunk** _page_slot(ChunkPage* page, U32 chunk_x, U32 chunk_y) {
+    return &page->chunks[(chunk_y % PAGE_WIDTH) * PAGE_WIDTH +
+                         chunk_x % PAGE_WIDTH];
+  }
+
+  // nullptr for chunks that were never touched
+  Chunk* _find_chunk(U32 chunk_x, U32 chunk_y) {
     assert(chunk_x < _chunks_x_count && chunk_y < _chunks_y_count &&
            "Chunk out of bounds");
 
-    U16 chunk_index = chunk_x + chunk_y * _chunks_x_count;
+    auto page = hashmap::value(_pages, _page_key(chunk_x, chunk_y));
+
+    return page ? *_page_slot(*page, chunk_x, chunk_y) : nullptr;
+  }
 
-    auto chunk = sparse::value(alive, chunk_index);
+  bool _rect_empty(const DirtyRect& rect) { return rect.min_x > rect.max_x; }
 
-    if (!chunk) {
-      chunk = sparse::value(dead, chunk_index);
+  void _rect_add(DirtyRect& rect, U8 x, U8 y) {
+    rect.min_x = std::min(rect.min_x, x);
+    rect.min_y = std::min(rect.min_y, y);
+    rect.max_x = std::max(rect.max_x, x);
+    rect.max_y = std::max(rect.max_y, y);
+  }
+
+  void _rect_add(DirtyRect& rect, const DirtyRect& other) {
+    if (_rect_empty(other)) return;
+
+    _rect_add(rect, other.min_x, other.min_y);
+    _rect_add(rect, other.max_x, other.max_y);
+  }
+
+  DirtyRect _rect_grow(const DirtyRect& rect, U8 border) {
+    if (_rect_empty(rect)) return rect;
+
+    return DirtyRect{
+        .min_x = static_cast<U8>(std::max(rect.min_x - border, 0)),
+        .min_y = static_cast<U8>(std::max(rect.min_y - border, 0)),
+        .max_x = static_cast<U8>(std::min(rect.max_x + border, CHUNK_WIDTH - 1)),
+        .max_y =
+            static_cast<U8>(std::min(rect.max_y + border, CHUNK_HEIGHT - 1)),
+    };
+  }
+
+  // the part of rect grown by GHOST_BORDER_WIDTH that lands in the neighbour
+  // at dx, dy, in the neighbour's local coordinates
+  DirtyRect _neighbour_rect(const DirtyRect& rect, I8 dx, I8 dy) {
+    if (_rect_empty(rect)) return rect;
+
+    I32 min_x = rect.min_x - GHOST_BORDER_WIDTH - dx * CHUNK_WIDTH;
+    I32 min_y = rect.min_y - GHOST_BORDER_WIDTH - dy * CHUNK_HEIGHT;
+    I32 max_x = rect.max_x + GHOST_BORDER_WIDTH - dx * CHUNK_WIDTH;
+    I32 max_y = rect.max_y + GHOST_BORDER_WIDTH - dy * CHUNK_HEIGHT;
+
+    if (max_x < 0 || max_y < 0 || min_x >= CHUNK_WIDTH ||
+        min_y >= CHUNK_HEIGHT) {
+      return DirtyRect{};
+    }
+
+    return DirtyRect{
+        .min_x = static_cast<U8>(std::max(min_x, 0)),
+        .min_y = static_cast<U8>(std::max(min_y, 0)),
+        .max_x = static_cast<U8>(std::min(max_x, CHUNK_WIDTH - 1)),
+        .max_y = static_cast<U8>(std::min(max_y, CHUNK_HEIGHT - 1)),
+    };
+  }
+
+  BorderChange _border_changes(const DirtyRect& rect) {
+    auto border_changes = BorderChange::NONE;
+
+    for (auto& neighbour : NEIGHBOURS) {
+      if (!_rect_empty(_neighbour_rect(rect, neighbour.dx, neighbour.dy))) {
+        border_changes = border_changes | neighbour.border;
+      }
+    }
+
+    return border_changes;
+  }
+
+  // x and y are chunk local and must be outside the chunk by at most
+  // GHOST_BORDER_WIDTH. a run of cells along x stays contiguous in the halo
+  Cell* _halo_cell(Chunk* chunk, I32 x, I32 y) {
+    auto halo = chunk->halo.data;
+
+    if (y < 0) {
+      return halo + (y + GHOST_BORDER_WIDTH) * HALO_ROW_WIDTH + x +
+             GHOST_BORDER_WIDTH;
+    }
+
+    if (y >= CHUNK_HEIGHT) {
+      return halo + HALO_BAND_SIZE + (y - CHUNK_HEIGHT) * HALO_ROW_WIDTH + x +
+             GHOST_BORDER_WIDTH;
+    }
+
+    auto sides = halo + 2 * HALO_BAND_SIZE;
+
+    if (x < 0) return sides + y * GHOST_BORDER_WIDTH + x + GHOST_BORDER_WIDTH;
+
+    return sides + (CHUNK_HEIGHT + y) * GHOST_BORDER_WIDTH + x - CHUNK_WIDTH;
+  }
+
+  // the cells of a chunk that show up in the halo of the neighbour at dx, dy
+  DirtyRect _border_band(I8 dx, I8 dy) {
+    const U8 far = CHUNK_WIDTH - GHOST_BORDER_WIDTH;
+
+    return DirtyRect{
+        .min_x = static_cast<U8>(dx > 0 ? far : 0),
+        .min_y = static_cast<U8>(dy > 0 ? far : 0),
+        .max_x = static_cast<U8>(dx < 0 ? GHOST_BORDER_WIDTH - 1
+                                        : CHUNK_WIDTH - 1),
+        .max_y = static_cast<U8>(dy < 0 ? GHOST_BORDER_WIDTH - 1
+                                        : CHUNK_HEIGHT - 1),
+    };
+  }
+
+  bool _chunk_in_level(I32 chunk_x, I32 chunk_y) {
+    return chunk_x >= 0 && chunk_y >= 0 && chunk_x < I32(_chunks_x_count) &&
+           chunk_y < I32(_chunks_y_count);
+  }
+
+  // copies the border band of source that target at dx, dy from it sees
+  // into target's halo
+  void _copy_band(Chunk* source, Chunk* target, I8 dx, I8 dy) {
+    auto front = source->cells[source->front].data;
+    auto band  = _border_band(dx, dy);
+
+    for (I32 y = band.min_y; y <= band.max_y; ++y) {
+      memcpy(_halo_cell(target,
+                        band.min_x - dx * CHUNK_WIDTH,
+                        y - dy * CHUNK_HEIGHT),
+             front + y * CHUNK_WIDTH + band.min_x,
+             (band.max_x - band.min_x + 1) * sizeof(Cell));
     }
+  }
 
-    assert(chunk != nullptr && "Chunk not found");
+  // copies the border band facing every flagged neighbour into that
+  // neighbour's halo. each halo cell has exactly one source chunk, so chunks
+  // can push concurrently. neighbours that were never allocated or are not
+  // resident are skipped, they pull their halo when they become resident
+  void _push_halos(Chunk* chunk, BorderChange border_changes) {
+    for (auto& neighbour : NEIGHBOURS) {
+      if (!(border_changes & neighbour.border)) continue;
 
-    return chunk;
+      I32 neighbour_x = chunk->x + neighbour.dx;
+      I32 neighbour_y = chunk->y + neighbour.dy;
+
+      if (!_chunk_in_level(neighbour_x, neighbour_y)) continue;
+
+      auto target = _find_chunk(neighbour_x, neighbour_y);
+
+      if (target && target->residency == Residency::RESIDENT) {
+        _copy_band(chunk, target, neighbour.dx, neighbour.dy);
+      }
+    }
   }
 
-  Chunk* _get_chunk_global(U32 x, U32 y) {
-    U32 chunk_x = x / CHUNK_WIDTH;
-    U32 chunk_y = y / CHUNK_HEIGHT;
+  // refreshes the halo from every resident neighbour. pushes skip chunks
+  // that are not resident, so this runs whenever a chunk becomes resident
+  void _pull_halo(Chunk* chunk) {
+    for (auto& neighbour : NEIGHBOURS) {
+      I32 neighbour_x = chunk->x + neighbour.dx;
+      I32 neighbour_y = chunk->y + neighbour.dy;
+
+      if (!_chunk_in_level(neighbour_x, neighbour_y)) continue;
 
-    return _get_chunk(chunk_x, chunk_y);
+      auto source = _find_chunk(neighbour_x, neighbour_y);
+
+      if (source && source->residency == Residency::RESIDENT) {
+        _copy_band(source, chunk, -neighbour.dx, -neighbour.dy);
+      }
+    }
   }
 
-  MaterialType* _cell_material(Chunk* chunk, U32 x, U32 y) {
-    if (y < CHUNK_HEIGHT - 1) {
-      return &chunk->materials[current_buffer_index]
-                  .data[(y + 1) * CHUNK_WIDTH + x];
+  // woken, updated or allocated since the last checkpoint
+  void _touch(Chunk* chunk) { simulation::checkpoints::touch(chunk->index); }
+
+  // the next label pass looks at the rect's solids again, if the chunk has
+  // any
+  void _reshape(Chunk* chunk, const DirtyRect& rect) {
+    if (_rect_empty(rect)) return;
+    if (!chunk->solids && !(chunk->materials & simulation::materials::SOLID)) {
+      return;
     }
-    return nullptr;
+
+    if (_rect_empty(chunk->reshaped)) array::push_back(_reshaped, chunk);
+
+    _rect_add(chunk->reshaped, rect);
   }
 
-  Chunk _init_chunk(U8 chunk_x, U8 chunk_y) {
-    Chunk new_chunk{.x = chunk_x, .y = chunk_y};
+  // the field a tick reads, nullptr for cold chunks
+  F32* _heat(Chunk* chunk) {
+    if (!chunk->heat) return nullptr;
+
+    return chunk->heat + _heat_front * simulation::heat::CELLS;
+  }
+
+  void _bind_block(Chunk* chunk, U8* block) {
+    chunk->block = block;
 
     for (U8 buffer_i = 0; buffer_i < 2; ++buffer_i) {
-      new_chunk.materials[buffer_i] =
-          array::init<MaterialType, CHUNK_WIDTH_HEIGHT>(mem_level,
-                                                        MaterialType::AIR);
+      chunk->cells[buffer_i].data = reinterpret_cast<Cell*>(block);
+      block += CHUNK_WIDTH_HEIGHT * sizeof(Cell);
+
+#ifndef SIMULATION_PACKED_CELLS
+      chunk->velocity_x[buffer_i].data = block;
+      block += CHUNK_WIDTH_HEIGHT;
+      chunk->velocity_y[buffer_i].data = block;
+      block += CHUNK_WIDTH_HEIGHT;
+      chunk->flags[buffer_i].data = block;
+      block += CHUNK_WIDTH_HEIGHT;
+#endif
+    }
 
-      new_chunk.velocity_x[buffer_i] =
-          array::init<U8, CHUNK_WIDTH_HEIGHT>(mem_level);
-      new_chunk.velocity_y[buffer_i] =
-          array::init<U8, CHUNK_WIDTH_HEIGHT>(mem_level);
+    chunk->halo.data = reinterpret_cast<Cell*>(block);
+  }
+
+  // callers fill the whole block, from the page file, the packed cells or
+  // with air, so neither recycled nor new blocks are cleared here
+  void _attach_block(Chunk* chunk) {
+    U8* block = nullptr;
 
-      new_chunk.flags[buffer_i] =
-          array::init<U8, CHUNK_WIDTH_HEIGHT>(mem_level);
+    if (_free_blocks._size > 0) {
+      block = _free_blocks._data[--_free_blocks._size];
+    } else {
+      block = arena::alloc_uninit(mem_level, simulation::chunk_bytes());
     }
 
-    printf("Initialized chunk at %d, %d\n", new_chunk.x, new_chunk.y);
+    _bind_block(chunk, block);
+    array::push_back(_resident, chunk);
+  }
 
-    return new_chunk;
+  U64 _elapsed_ns(std::chrono::steady_clock::time_point started) {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+               std::chrono::steady_clock::now() - started)
+        .count();
   }
 
-  void _init_gpu_memory() {
-    U32 start_chunk_x = _view_x / CHUNK_WIDTH;
-    U32 start_chunk_y = _view_y / CHUNK_HEIGHT;
-    U32 end_x         = _view_x + VIEW_WIDTH - 1;
-    U32 end_y         = _view_y + VIEW_HEIGHT - 1;
-    U32 num_chunks_x  = (end_x / CHUNK_WIDTH) - start_chunk_x + 1;
-    U32 num_chunks_y  = (end_y / CHUNK_HEIGHT) - start_chunk_y + 1;
+  // blocks until the page thread has passed ticket
+  void _stall(U64 ticket) {
+    if (simulation::pages::done(ticket)) return;
+
+    auto started = std::chrono::steady_clock::now();
 
-    printf("%d %d chunks in view: %u x %u\n",
-           _view_x,
-           _view_y,
-           num_chunks_x,
-           num_chunks_y);
+    simulation::pages::wait(ticket);
 
-    for (U32 chunk_y = start_chunk_y; chunk_y < start_chunk_y + num_chunks_y;
-         ++chunk_y) {
-      for (U32 chunk_x = start_chunk_x; chunk_x < start_chunk_x + num_chunks_x;
-           ++chunk_x) {
+    _stats.page_stall_ns += _elapsed_ns(started);
+  }
+
+  U32 _packing_bytes() {
+    U32 bytes = simulation::rle::max_bytes<Cell>(CHUNK_WIDTH_HEIGHT) +
+                simulation::rle::max_bytes<Cell>(HALO_SIZE);
+
+#ifndef SIMULATION_PACKED_CELLS
+    bytes += 3 * simulation::rle::max_bytes<U8>(CHUNK_WIDTH_HEIGHT);
+#endif
+
+    return bytes;
+  }
+
+  // codes the front buffer, its planes and the halo into _packing. the back
+  // buffer is rewritten by the next update, it is not kept
+  U32 _pack(Chunk* chunk) {
+    U8* out   = _packing;
+    U8  front = chunk->front;
+
+    out += simulation::rle::encode(
+        chunk->cells[front].data, CHUNK_WIDTH_HEIGHT, out);
+#ifndef SIMULATION_PACKED_CELLS
+    out += simulation::rle::encode(
+        chunk->velocity_x[front].data, CHUNK_WIDTH_HEIGHT, out);
+    out += simulation::rle::encode(
+        chunk->velocity_y[front].data, CHUNK_WIDTH_HEIGHT, out);
+    out += simulation::rle::encode(
+        chunk->flags[front].data, CHUNK_WIDTH_HEIGHT, out);
+#endif
+    out += simulation::rle::encode(chunk->halo.data, HALO_SIZE, out);
+
+    return out - _packing;
+  }
+
+  void _unpack(Chunk* chunk) {
+    const U8* in    = chunk->packed;
+    U8        front = chunk->front;
+
+    in += simulation::rle::decode(
+        in, CHUNK_WIDTH_HEIGHT, chunk->cells[front].data);
+#ifndef SIMULATION_PACKED_CELLS
+    in += simulation::rle::decode(
+        in, CHUNK_WIDTH_HEIGHT, chunk->velocity_x[front].data);
+    in += simulation::rle::decode(
+        in, CHUNK_WIDTH_HEIGHT, chunk->velocity_y[front].data);
+    in += simulation::rle::decode(
+        in, CHUNK_WIDTH_HEIGHT, chunk->flags[front].data);
+#endif
+    in += simulation::rle::decode(in, HALO_SIZE, chunk->halo.data);
+
+    assert(U32(in - chunk->packed) == chunk->packed_bytes &&
+           "Packed chunk size mismatch");
+  }
+
+  // returns false, keeping the chunk resident, when coding would not save
+  // at least half of its block
+  bool _compress(Chunk* chunk) {
+    U32 bytes = _pack(chunk);
+
+    if (bytes > simulation::chunk_bytes() / 2) return false;
+
+    if (bytes > chunk->packed_capacity) {
+      chunk->packed_capacity = (bytes + 63) & ~63u;
+      chunk->packed = arena::alloc_uninit(mem_level, chunk->packed_capacity);
+    }
+
+    memcpy(chunk->packed, _packing, bytes);
+    chunk->packed_bytes = bytes;
+
+    array::push_back(_free_blocks, chunk->block);
+    chunk->block     = nullptr;
+    chunk->residency = Residency::COMPRESSED;
+
+    ++_stats.chunks_compressed;
+    _stats.compressed_bytes += bytes;
 
-        printf("getting chunk %d %d\n", chunk_x, chunk_y);
-        auto chunk = _get_chunk(chunk_x, chunk_y);
+    return true;
+  }
+
+  void _decompress(Chunk* chunk) {
+    auto started = std::chrono::steady_clock::now();
+
+    _attach_block(chunk);
+    _unpack(chunk);
+
+    --_stats.chunks_compressed;
+    _stats.compressed_bytes -= chunk->packed_bytes;
+
+    ++_stats.chunks_decompressed;
+    _stats.decompress_ns += _elapsed_ns(started);
+  }
+
+  // makes the chunk's cells readable and writable, loading them from the
+  // page file when they were evicted
+  void _require(Chunk* chunk) {
+    switch (chunk->residency) {
+      case Residency::RESIDENT: {
+        if (chunk->prefetched) {
+          chunk->prefetched = false;
+          ++_stats.page_hits;
+        }
+        return;
+      }
+      case Residency::STORING: {
+        // the block is still there, keep it
+        _stall(chunk->io_ticket);
+        break;
+      }
+      case Residency::LOADING: {
+        ++_stats.page_misses;
+        _stall(chunk->io_ticket);
+        break;
+      }
+      case Residency::STORED: {
+        ++_stats.page_misses;
+        _attach_block(chunk);
 
-        printf("got chunk %d %d\n", chunk->x, chunk->y);
+        auto started = std::chrono::steady_clock::now();
 
-        U32 gpu_offset =
-            (chunk_y * CHUNK_HEIGHT) * (CHUNK_WIDTH * num_chunks_x) +
-            (chunk_x * CHUNK_WIDTH);
+        simulation::pages::read_now(chunk->page_record, chunk->block);
+        ++_stats.pages_read;
 
-        memcpy(_gpu_memory + gpu_offset,
-               chunk->materials[current_buffer_index].data,
-               CHUNK_WIDTH * CHUNK_HEIGHT);
+        _stats.page_stall_ns += _elapsed_ns(started);
+        break;
+      }
+      case Residency::COMPRESSED: {
+        _decompress(chunk);
+        break;
       }
     }
 
-    printf("GPU memory initialized\n");
+    chunk->residency = Residency::RESIDENT;
+    chunk->slept_at  = _tick;
+    _pull_halo(chunk);
   }
 
-  void _update_gpu_memory() {
-    U32 start_chunk_x = _view_x / CHUNK_WIDTH;
-    U32 start_chunk_y = _view_y / CHUNK_HEIGHT;
-    U32 num_chunks_x  = (VIEW_WIDTH + CHUNK_WIDTH - 1) / CHUNK_WIDTH;
-    U32 num_chunks_y  = (VIEW_HEIGHT + CHUNK_HEIGHT - 1) / CHUNK_HEIGHT;
+  // halo regions facing outside the level read as BORDER, the ones of
+  // neighbours that exist are pulled from them and the rest are AIR. the
+  // regions don't overlap, every halo cell is written once
+  void _init_halo(Chunk* chunk) {
+    for (auto& neighbour : NEIGHBOURS) {
+      I32 neighbour_x = chunk->x + neighbour.dx;
+      I32 neighbour_y = chunk->y + neighbour.dy;
+
+      auto fill = MaterialType::BORDER;
+
+      if (_chunk_in_level(neighbour_x, neighbour_y)) {
+        auto source = _find_chunk(neighbour_x, neighbour_y);
 
-    for (U32 chunk_y = start_chunk_y; chunk_y < start_chunk_y + num_chunks_y;
-         ++chunk_y) {
-      for (U32 chunk_x = start_chunk_x; chunk_x < start_chunk_x + num_chunks_x;
-           ++chunk_x) {
-        U16 chunk_index = chunk_x + chunk_y * num_chunks_x;
+        if (source) {
+          _require(source);
+          _copy_band(source, chunk, -neighbour.dx, -neighbour.dy);
+          continue;
+        }
+
+        fill = MaterialType::AIR;
+      }
 
-        if (chunk_index >= alive._size) continue;
+      // the band this chunk would push, seen from the missing neighbour
+      auto band = _border_band(-neighbour.dx, -neighbour.dy);
 
-        auto chunk = sparse::value(alive, chunk_index);
+      for (I32 y = band.min_y; y <= band.max_y; ++y) {
+        std::fill_n(_halo_cell(chunk,
+                               band.min_x + neighbour.dx * CHUNK_WIDTH,
+                               y + neighbour.dy * CHUNK_HEIGHT),
+                    band.max_x - band.min_x + 1,
+                    simulation::cells::make(fill));
+      }
+    }
+  }
 
-        if (!chunk) continue;
+  // materials the chunk and its halo may hold
+  U16 _neighbourhood_materials(Chunk* chunk) {
+    U16 materials = chunk->materials;
 
-        U32 gpu_offset =
-            (chunk_y * CHUNK_HEIGHT) * (CHUNK_WIDTH * num_chunks_x) +
-            (chunk_x * CHUNK_WIDTH);
+    for (auto& neighbour : NEIGHBOURS) {
+      I32 neighbour_x = chunk->x + neighbour.dx;
+      I32 neighbour_y = chunk->y + neighbour.dy;
 
-        memcpy(_gpu_memory + gpu_offset,
-               chunk->materials[current_buffer_index].data,
-               CHUNK_WIDTH * CHUNK_HEIGHT);
+      if (!_chunk_in_level(neighbour_x, neighbour_y)) {
+        materials |= simulation::materials::bit(MaterialType::BORDER);
+        continue;
       }
+
+      auto source = _find_chunk(neighbour_x, neighbour_y);
+
+      if (source) materials |= source->materials;
     }
+
+    return materials;
   }
-}
 
-void print_sim() {
-  U32 per_line_count = 0;
-  U32 line_count     = 0;
+  U16 _scan_materials(Chunk* chunk) {
+    U16  materials = 0;
+    auto cells     = chunk->cells[chunk->front].data;
 
-  for (U32 i = 0; i < 192 * 108; ++i) {
-    printf("%c",
-           _gpu_memory[i] == static_cast<U8>(MaterialType::AIR) ? '.' : '#');
-    if (++per_line_count == 192) {
-      printf(" - %d\n", line_count++);
-      per_line_count = 0;
+    for (U32 i = 0; i < CHUNK_WIDTH_HEIGHT; ++i) {
+      materials |= 1 << U8(simulation::cells::material(cells[i]));
     }
+
+    return materials;
   }
-}
 
-void simulation::init(
-    U32 view_x, U32 view_y, U32 level_width, U32 level_height, U8* gpu_memory) {
-  assert(level_width % CHUNK_WIDTH == 0 &&
-         "Level width must be a multiple of CHUNK_WIDTH");
-  assert(level_height % CHUNK_HEIGHT == 0 &&
-         "Level height must be a multiple of CHUNK_HEIGHT");
+  // row y of the chunk from column -1 to 64, with the halo around it
+  void _window_row(Chunk* chunk, I32 y, Cell* out) {
+    if (y < 0 || y >= CHUNK_HEIGHT) {
+      memcpy(out, _halo_cell(chunk, -1, y), (CHUNK_WIDTH + 2) * sizeof(Cell));
+      return;
+    }
 
-  _view_x = view_x;
-  _view_y = view_y;
+    out[0] = *_halo_cell(chunk, -1, y);
+    memcpy(out + 1,
+           chunk->cells[chunk->front].data + y * CHUNK_WIDTH,
+           CHUNK_WIDTH * sizeof(Cell));
+    out[CHUNK_WIDTH + 1] = *_halo_cell(chunk, CHUNK_WIDTH, y);
+  }
 
-  _chunks_x_count = level_width / CHUNK_WIDTH;
-  _chunks_y_count = level_height / CHUNK_HEIGHT;
+  // runs the material rules over the active rows. slower than the row
+  // kernels, used for chunks with anything but SAND moving around
+  void _update_chunk_rules(Chunk* chunk) {
+    const U32 ROW = CHUNK_WIDTH + 2;
+
+    // rows -1 to 66, row y starts at window + (y + 1) * ROW
+    Cell window[(CHUNK_HEIGHT + 3) * ROW];
 
-  _chunks_count = _chunks_x_count * _chunks_y_count;
+    auto active = chunk->active;
+    auto back   = chunk->cells[chunk->front ^ 1].data;
+    auto heat   = _heat(chunk);
 
-  alive = sparse::init16<Chunk, MAX_CHUNKS, MAX_CHUNKS>(mem_level);
-  dead  = sparse::init16<Chunk, MAX_CHUNKS, MAX_CHUNKS>(mem_level);
+    // the chunk's own stream for reactions. liquids flow the same way along
+    // a whole level row, or the chunks on both sides of a border would
+    // disagree about a move across it, so directions come from a stream
+    // keyed by the chunk row alone
+    auto stream = simulation::random::stream(_tick, chunk->x, chunk->y);
+    auto flows  = simulation::random::stream(_tick, U32_MAX, chunk->y);
 
-  for (U32 chunk_y = 0; chunk_y < _chunks_y_count; ++chunk_y) {
-    for (U32 chunk_x = 0; chunk_x < _chunks_x_count; ++chunk_x) {
-      Chunk new_chunk = _init_chunk(chunk_x, chunk_y);
+    for (I32 y = active.min_y - 1; y <= active.max_y + 2; ++y) {
+      _window_row(chunk, y, window + (y + 1) * ROW);
+    }
+
+    for (U32 y = active.min_y; y <= active.max_y; ++y) {
+      const Cell* rows[4] = {
+          window + y * ROW + 1,
+          window + (y + 1) * ROW + 1,
+          window + (y + 2) * ROW + 1,
+          window + (y + 3) * ROW + 1,
+      };
+
+      I8  dir     = simulation::random::draw(flows, y) & 1 ? 1 : -1;
+      U32 counter = y * CHUNK_WIDTH * simulation::materials::DRAWS;
+      U64 busy    = 0;
+
+      auto heat_row =
+          heat ? heat + (y / simulation::heat::SCALE) * simulation::heat::WIDTH
+               : nullptr;
+
+      U64 changed = simulation::materials::update_row(rows,
+                                                      heat_row,
+                                                      back + y * CHUNK_WIDTH,
+                                                      active.min_x,
+                                                      active.max_x,
+                                                      dir,
+                                                      stream,
+                                                      counter,
+                                                      busy,
+                                                      chunk->materials_seen);
+
+      if (busy) {
+        _rect_add(chunk->busy, std::countr_zero(busy), y);
+        _rect_add(chunk->busy, CHUNK_WIDTH - 1 - std::countl_zero(busy), y);
+      }
+
+      if (!changed) continue;
 
-      sparse::insert(alive,
-                     static_cast<U16>(chunk_x + chunk_y * _chunks_x_count),
-                     new_chunk);
+      _rect_add(chunk->dirty, std::countr_zero(changed), y);
+      _rect_add(chunk->dirty, CHUNK_WIDTH - 1 - std::countl_zero(changed), y);
     }
   }
 
-  printf("after insert:\n");
-  for (U32 i = 0; i < _chunks_count; ++i) {
-    auto chunk = sparse::value(alive, static_cast<U16>(i));
-    if (!chunk) continue;
+  // runs the row kernel over the active rows, for chunks where only SAND
+  // can move
+  void _update_chunk_falling(Chunk* chunk) {
+    auto active = chunk->active;
+    auto front  = chunk->cells[chunk->front].data;
+    auto back   = chunk->cells[chunk->front ^ 1].data;
+
+    for (U32 y = active.min_y; y <= active.max_y; ++y) {
+      auto row   = front + y * CHUNK_WIDTH;
+      auto above = y > 0 ? row - CHUNK_WIDTH : _halo_cell(chunk, 0, -1);
+      auto below = y < CHUNK_HEIGHT - 1 ? row + CHUNK_WIDTH
+                                        : _halo_cell(chunk, 0, CHUNK_HEIGHT);
+
+      U64 changed = _fall_row(above,
+                              row,
+                              below,
+                              back + y * CHUNK_WIDTH,
+                              active.min_x,
+                              active.max_x);
+
+      if (!changed) continue;
+
+      _rect_add(chunk->dirty, std::countr_zero(changed), y);
+      _rect_add(chunk->dirty, CHUNK_WIDTH - 1 - std::countl_zero(changed), y);
+    }
+  }
+
+  void _update_chunk(Chunk* chunk) {
+    auto active = chunk->active;
+    auto front  = chunk->cells[chunk->front].data;
+    auto back   = chunk->cells[chunk->front ^ 1].data;
+
+    memcpy(back, front, active.min_y * CHUNK_WIDTH * sizeof(Cell));
+    memcpy(back + (active.max_y + 1) * CHUNK_WIDTH,
+           front + (active.max_y + 1) * CHUNK_WIDTH,
+           (CHUNK_HEIGHT - 1 - active.max_y) * CHUNK_WIDTH * sizeof(Cell));
+
+    if (!chunk->heat && simulation::materials::fall_kernel_handles(
+                            _neighbourhood_materials(chunk))) {
+      _update_chunk_falling(chunk);
+    } else {
+      _update_chunk_rules(chunk);
+    }
+
+    chunk->front ^= 1;
 
-    printf("Chunk %d: %d, %d at %p\n", i, chunk->x, chunk->y, (void*)chunk);
+    chunk->border_changes = _border_changes(chunk->dirty);
   }
 
-  _gpu_memory = gpu_memory;
-  _init_gpu_memory();
+  Chunk* _init_chunk(U32 chunk_x, U32 chunk_y) {
+    auto new_chunk = arena::alloc_uninit<Chunk>(mem_level, sizeof(Chunk));
+    *new_chunk     = Chunk{.x = chunk_x, .y = chunk_y, .index = _chunks._size};
 
-  print_sim();
-}
+    // recycled blocks hold an evicted chunk's cells. every byte of the
+    // block is written once: cells with air, the planes with zero and the
+    // halo from the neighbours
+    _attach_block(new_chunk);
 
-void simulation::simulate() {
-  for (U32 i = 0; i < alive._size; ++i) {
-    auto chunk = &alive._data.data[i];
+    for (U8 buffer_i = 0; buffer_i < 2; ++buffer_i) {
+      std::fill_n(new_chunk->cells[buffer_i].data,
+                  CHUNK_WIDTH_HEIGHT,
+                  simulation::cells::make(MaterialType::AIR));
+#ifndef SIMULATION_PACKED_CELLS
+      // velocity_x, velocity_y and flags follow the cells
+      memset(new_chunk->velocity_x[buffer_i].data, 0, 3 * CHUNK_WIDTH_HEIGHT);
+#endif
+    }
 
-    for (U32 y = 0; y < CHUNK_HEIGHT; ++y) {
-      for (U32 x = 0; x < CHUNK_WIDTH; ++x) {
-        const U16 index = y * CHUNK_WIDTH + x;
-
-        auto material = &chunk->materials[current_buffer_index].data[index];
-
-        switch (*material) {
-          case MaterialType::SAND: {
-            auto down_one_material = _cell_material(chunk, x, y + 1);
-            if (y < CHUNK_HEIGHT - 1 &&
-                *down_one_material == MaterialType::AIR) {
-              *down_one_material = *material;
-              *material          = MaterialType::AIR;
-            }
-            break;
-          }
-          default:
-            break;
-        }
+    _init_halo(new_chunk);
+
+    array::push_back(_chunks, new_chunk);
+    ++_stats.chunks_allocated;
+
+    _touch(new_chunk);
+
+    return new_chunk;
+  }
+
+  // allocates the chunk and its page on first use
+  Chunk* _get_chunk(U32 chunk_x, U32 chunk_y) {
+    assert(chunk_x < _chunks_x_count && chunk_y < _chunks_y_count &&
+           "Chunk out of bounds");
+
+    U64  key  = _page_key(chunk_x, chunk_y);
+    auto page = hashmap::value(_pages, key);
+
+    if (!page) {
+      page  = hashmap::insert(_pages, key, nullptr);
+      *page = arena::alloc<ChunkPage>(mem_level, sizeof(ChunkPage));
+    }
+
+    auto slot = _page_slot(*page, chunk_x, chunk_y);
+
+    if (!*slot) *slot = _init_chunk(chunk_x, chunk_y);
+
+    return *slot;
+  }
+
+  void _wake_chunk(U32 chunk_x, U32 chunk_y, const DirtyRect& rect) {
+    auto chunk = _get_chunk(chunk_x, chunk_y);
+
+    _require(chunk);
+    _touch(chunk);
+
+    if (!chunk->awake) {
+      chunk->awake = true;
+      array::push_back(_awake, chunk);
+    }
+
+    _rect_add(chunk->active, rect);
+  }
+
+  void _wake_neighbours(U32              chunk_x,
+                        U32              chunk_y,
+                        BorderChange     border_changes,
+                        const DirtyRect& rect) {
+    for (auto& neighbour : NEIGHBOURS) {
+      if (!(border_changes & neighbour.border)) continue;
+
+      I32 neighbour_x = chunk_x + neighbour.dx;
+      I32 neighbour_y = chunk_y + neighbour.dy;
+
+      if (!_chunk_in_level(neighbour_x, neighbour_y)) continue;
+
+      _wake_chunk(neighbour_x,
+                  neighbour_y,
+                  _neighbour_rect(rect, neighbour.dx, neighbour.dy));
+    }
+  }
+
+  // moves the finished tick's dirty rects into the next tick's active rects,
+  // wakes neighbours touched through the border band and puts chunks with
+  // nothing left to do to sleep
+  void _schedule_chunks() {
+    U32 updated_count = _awake._size;
+
+    // a cell's next value depends on rows y - 1 to y + 2 around it. busy
+    // cells may move next tick, the cells they move into have to be looked
+    // at too
+    for (U32 i = 0; i < updated_count; ++i) {
+      auto chunk    = _awake._data[i];
+      chunk->active = _rect_grow(chunk->dirty, 2);
+      chunk->hashed = chunk->hashed && _rect_empty(chunk->dirty);
+
+      _rect_add(chunk->active, _rect_grow(chunk->busy, 2));
+      _rect_add(chunk->gpu_dirty, chunk->dirty);
+
+      chunk->materials      |= chunk->materials_seen;
+      chunk->materials_seen  = 0;
+
+      _touch(chunk);
+
+      _reshape(chunk, chunk->dirty);
+    }
+
+    for (U32 i = 0; i < updated_count; ++i) {
+      auto chunk = _awake._data[i];
+
+      if (chunk->border_changes != BorderChange::NONE) {
+        _wake_neighbours(chunk->x,
+                         chunk->y,
+                         chunk->border_changes,
+                         chunk->dirty);
+      }
+
+      // busy cells at the border may move into a neighbour later
+      auto busy_changes = _border_changes(chunk->busy);
+
+      if (busy_changes != BorderChange::NONE) {
+        _wake_neighbours(chunk->x, chunk->y, busy_changes, chunk->busy);
+      }
+
+      chunk->border_changes = BorderChange::NONE;
+      chunk->dirty          = DirtyRect{};
+      chunk->busy           = DirtyRect{};
+    }
+
+    U32 awake_count = 0;
+
+    for (U32 i = 0; i < _awake._size; ++i) {
+      auto chunk = _awake._data[i];
+
+      if (_rect_empty(chunk->active)) {
+        chunk->awake     = false;
+        chunk->slept_at  = _tick;
+        chunk->materials = _scan_materials(chunk);
+        continue;
       }
+
+      _awake._data[awake_count++] = chunk;
     }
+
+    _awake._size = awake_count;
+
+    _stats.chunks_updated = updated_count;
+    _stats.chunks_awake   = awake_count;
   }
 
-  current_buffer_index = (current_buffer_index + 1) % 2;
+  void _update_awake_chunk(U32 index) { _update_chunk(_awake._data[index]); }
 
-  // _update_gpu_memory();
+  // wakes everything that can see the cells of rect, which were changed
+  // outside of a tick, and copies them to the halos around the chunk
+  void _cells_changed(Chunk* chunk, const DirtyRect& rect) {
+    _wake_chunk(chunk->x, chunk->y, _rect_grow(rect, 1));
+    _wake_neighbours(chunk->x, chunk->y, _border_changes(rect), rect);
 
-  // print_sim();
-  printf("-------\n");
-}
+    chunk->hashed = false;
 
-void simulation::set_view(U32 x, U32 y) {
-  _view_x = x;
-  _view_y = y;
-}
+    _push_halos(chunk, _border_changes(rect));
+    _rect_add(chunk->gpu_dirty, rect);
+    _reshape(chunk, rect);
+  }
 
-void simulation::add_cell(U32 x, U32 y, MaterialType type) {
-  auto chunk = _get_chunk_global(x, y);
+  // add_cell without the recording, also used for landing particles
+  void _place_cell(U32 x, U32 y, MaterialType type) {
+    U32 local_x = x % CHUNK_WIDTH;
+    U32 local_y = y % CHUNK_HEIGHT;
+
+    auto chunk = _get_chunk(x / CHUNK_WIDTH, y / CHUNK_HEIGHT);
+
+    _require(chunk);
+
+    chunk->cells[chunk->front].data[local_y * CHUNK_WIDTH + local_x] =
+        simulation::cells::make(type);
+    chunk->materials |= simulation::materials::bit(type);
+
+    DirtyRect rect;
+    _rect_add(rect, local_x, local_y);
+
+    _cells_changed(chunk, rect);
+  }
+
+  void _velocity(Chunk* chunk, U32 index, I8& velocity_x, I8& velocity_y) {
+#ifdef SIMULATION_PACKED_CELLS
+    auto cell  = chunk->cells[chunk->front].data[index];
+    velocity_x = simulation::cells::velocity_x(cell);
+    velocity_y = simulation::cells::velocity_y(cell);
+#else
+    velocity_x = I8(chunk->velocity_x[chunk->front].data[index]);
+    velocity_y = I8(chunk->velocity_y[chunk->front].data[index]);
+#endif
+  }
+
+  void _set_velocity(Chunk* chunk, U32 index, I8 velocity_x, I8 velocity_y) {
+#ifdef SIMULATION_PACKED_CELLS
+    auto& cell = chunk->cells[chunk->front].data[index];
+    cell       = simulation::cells::with_velocity(cell, velocity_x, velocity_y);
+#else
+    chunk->velocity_x[chunk->front].data[index] = U8(velocity_x);
+    chunk->velocity_y[chunk->front].data[index] = U8(velocity_y);
+#endif
+  }
+
+  // pushed cells that can move leave the grid as particles, the velocity of
+  // the others is dropped
+  void _launch_cells() {
+    U32 launched = 0;
+
+    for (U32 i = 0; i < _pushed._size; ++i) {
+      auto chunk = _pushed._data[i];
+      auto rect  = chunk->pushed;
+
+      // the chunk may have been stored since it was pushed, bringing it
+      // back attaches a new block
+      _require(chunk);
+
+      auto cells = chunk->cells[chunk->front].data;
+
+      DirtyRect emptied;
+
+      chunk->pushed = DirtyRect{};
+
+      for (U32 y = rect.min_y; y <= rect.max_y; ++y) {
+        for (U32 x = rect.min_x; x <= rect.max_x; ++x) {
+          U32 index = y * CHUNK_WIDTH + x;
+          I8  velocity_x;
+          I8  velocity_y;
+
+          _velocity(chunk, index, velocity_x, velocity_y);
+
+          if (!velocity_x && !velocity_y) continue;
+
+          _set_velocity(chunk, index, 0, 0);
+
+          auto material = simulation::cells::material(cells[index]);
+
+          if (material == MaterialType::AIR ||
+              simulation::materials::rule(material).fixed) {
+            continue;
+          }
+
+          if (!simulation::particles::spawn(
+                  _particles,
+                  chunk->x * CHUNK_WIDTH + x + 0.5f,
+                  chunk->y * CHUNK_HEIGHT + y + 0.5f,
+                  velocity_x * CELL_VELOCITY,
+                  velocity_y * CELL_VELOCITY,
+                  material)) {
+            continue;
+          }
+
+          cells[index] = simulation::cells::make(MaterialType::AIR);
+          _rect_add(emptied, x, y);
+          ++launched;
+        }
+      }
+
+      if (!_rect_empty(emptied)) _cells_changed(chunk, emptied);
+    }
+
+    _pushed._size = 0;
+
+    _stats.particles_launched = launched;
+  }
+
+  // the chunk a particle looked at last, neighbouring samples and
+  // particles are mostly in the same one
+  struct ChunkCursor {
+    I32    x     = -1;
+    I32    y     = -1;
+    Chunk* chunk = nullptr;
+  };
+
+  // particles stop at anything but AIR and at the level's sides and bottom,
+  // above the level they fly on. sets pending instead of reading chunks
+  // that are not resident unless serial
+  bool _stops_particle(
+      I32 x, I32 y, bool serial, bool& pending, ChunkCursor& cursor) {
+    if (x < 0 || x >= I32(_chunks_x_count * CHUNK_WIDTH) ||
+        y >= I32(_chunks_y_count * CHUNK_HEIGHT)) {
+      return true;
+    }
+
+    if (y < 0) return false;
+
+    if (x / CHUNK_WIDTH != cursor.x || y / CHUNK_HEIGHT != cursor.y) {
+      cursor.x     = x / CHUNK_WIDTH;
+      cursor.y     = y / CHUNK_HEIGHT;
+      cursor.chunk = _find_chunk(cursor.x, cursor.y);
+    }
+
+    auto chunk = cursor.chunk;
+
+    if (!chunk) return false;
+
+    if (chunk->residency != Residency::RESIDENT) {
+      if (!serial) {
+        pending = true;
+        return false;
+      }
+
+      _require(chunk);
+    }
+
+    auto cell = chunk->cells[chunk->front]
+                    .data[(y % CHUNK_HEIGHT) * CHUNK_WIDTH + x % CHUNK_WIDTH];
+
+    return simulation::cells::material(cell) != MaterialType::AIR;
+  }
+
+  // moves the particle one tick along its path, sampled at most a cell
+  // apart so fast particles don't pass through thin walls. a landed
+  // particle is left at the last free sample
+  Flight _fly(U32 index, bool serial, ChunkCursor& cursor) {
+    auto& pool = _particles;
+
+    F32 x          = pool.x[index];
+    F32 y          = pool.y[index];
+    F32 velocity_x = pool.velocity_x[index];
+    F32 velocity_y = pool.velocity_y[index] + simulation::particles::GRAVITY;
+
+    // a path inside one chunk of nothing but AIR needs no samples
+    I32 start_x = I32(std::floor(x));
+    I32 start_y = I32(std::floor(y));
+    I32 end_x   = I32(std::floor(x + velocity_x));
+    I32 end_y   = I32(std::floor(y + velocity_y));
+
+    if (start_y >= 0 && end_y >= 0 && end_x >= 0 &&
+        end_x < I32(_chunks_x_count * CHUNK_WIDTH) &&
+        end_y < I32(_chunks_y_count * CHUNK_HEIGHT) &&
+        start_x / CHUNK_WIDTH == end_x / CHUNK_WIDTH &&
+        start_y / CHUNK_HEIGHT == end_y / CHUNK_HEIGHT) {
+      if (start_x / CHUNK_WIDTH != cursor.x ||
+          start_y / CHUNK_HEIGHT != cursor.y) {
+        cursor.x     = start_x / CHUNK_WIDTH;
+        cursor.y     = start_y / CHUNK_HEIGHT;
+        cursor.chunk = _find_chunk(cursor.x, cursor.y);
+      }
+
+      if (!cursor.chunk || cursor.chunk->materials ==
+                               simulation::materials::bit(MaterialType::AIR)) {
+        pool.x[index]          = x + velocity_x;
+        pool.y[index]          = y + velocity_y;
+        pool.velocity_x[index] = velocity_x;
+        pool.velocity_y[index] = velocity_y;
+
+        return Flight::FLYING;
+      }
+    }
+
+    F32 speed  = std::max(std::abs(velocity_x), std::abs(velocity_y));
+    U32 steps  = std::max(U32(std::ceil(speed)), 1u);
+    F32 step_x = velocity_x / steps;
+    F32 step_y = velocity_y / steps;
+
+    auto flight = Flight::FLYING;
+
+    for (U32 step = 0; step < steps; ++step) {
+      F32  next_x  = x + step_x;
+      F32  next_y  = y + step_y;
+      bool pending = false;
+
+      if (_stops_particle(I32(std::floor(next_x)),
+                          I32(std::floor(next_y)),
+                          serial,
+                          pending,
+                          cursor)) {
+        flight = Flight::LANDED;
+        break;
+      }
+
+      if (pending) return Flight::PENDING;
+
+      x = next_x;
+      y = next_y;
+    }
+
+    pool.x[index]          = x;
+    pool.y[index]          = y;
+    pool.velocity_x[index] = velocity_x;
+    pool.velocity_y[index] = velocity_y;
+
+    return flight;
+  }
+
+  void _fly_particles(U32 block) {
+    U32 end = std::min((block + 1) * PARTICLE_BLOCK, _particles.count);
+
+    ChunkCursor cursor;
+
+    for (U32 i = block * PARTICLE_BLOCK; i < end; ++i) {
+      _flights[i] = _fly(i, false, cursor);
+    }
+  }
+
+  // flies every particle, then lands the ones that hit something in pool
+  // order. a landing cell taken by an earlier particle this tick pushes the
+  // particle up the column, a particle landing above the level is lost
+  void _update_particles() {
+    U32 blocks = (_particles.count + PARTICLE_BLOCK - 1) / PARTICLE_BLOCK;
+
+    if (_parallel) {
+      jobs::parallel_for(blocks, _fly_particles);
+    } else {
+      for (U32 block = 0; block < blocks; ++block) {
+        _fly_particles(block);
+      }
+    }
+
+    ChunkCursor cursor;
+
+    for (U32 i = 0; i < _particles.count; ++i) {
+      if (_flights[i] == Flight::PENDING) _flights[i] = _fly(i, true, cursor);
+    }
+
+    U32 landed = 0;
+    U32 count  = 0;
+
+    for (U32 i = 0; i < _particles.count; ++i) {
+      if (_flights[i] == Flight::LANDED) {
+        I32  x       = I32(std::floor(_particles.x[i]));
+        I32  y       = I32(std::floor(_particles.y[i]));
+        bool pending = false;
+
+        // landings allocate chunks, the cursor can't outlive one
+        cursor = ChunkCursor{};
+
+        while (y >= 0 && _stops_particle(x, y, true, pending, cursor)) {
+          --y;
+        }
+
+        if (y >= 0) _place_cell(x, y, _particles.material[i]);
+
+        ++landed;
+        continue;
+      }
+
+      if (i != count) simulation::particles::move(_particles, i, count);
+      ++count;
+    }
+
+    _particles.count = count;
+
+    _stats.particles        = count;
+    _stats.particles_landed = landed;
+  }
+
+  void _push_awake_halos(U32 index) {
+    auto chunk = _awake._data[index];
+
+    _push_halos(chunk, chunk->border_changes);
+  }
+
+  // copies the rows of rect that are inside the view into the material ssbo,
+  // returns the number of bytes written. chunk is nullptr for chunks that
+  // were never allocated, their rows are AIR
+  U32 _upload_rect(U32              chunk_x,
+                   U32              chunk_y,
+                   Chunk*           chunk,
+                   const DirtyRect& rect) {
+    if (_rect_empty(rect)) return 0;
+
+    I32 chunk_left = I32(chunk_x * CHUNK_WIDTH) - I32(_view_x);
+    I32 chunk_top  = I32(chunk_y * CHUNK_HEIGHT) - I32(_view_y);
+
+    I32 min_x = std::max(chunk_left + rect.min_x, 0);
+    I32 min_y = std::max(chunk_top + rect.min_y, 0);
+    I32 max_x = std::min(chunk_left + rect.max_x, VIEW_WIDTH - 1);
+    I32 max_y = std::min(chunk_top + rect.max_y, VIEW_HEIGHT - 1);
+
+    if (min_x > max_x || min_y > max_y) return 0;
+
+    U32 span = max_x - min_x + 1;
+
+    if (!chunk) {
+      for (I32 y = min_y; y <= max_y; ++y) {
+        memset(_gpu_memory + y * VIEW_WIDTH + min_x,
+               static_cast<U8>(MaterialType::AIR),
+               span);
+      }
+
+      return span * (max_y - min_y + 1);
+    }
+
+    auto cells = chunk->cells[chunk->front].data;
+
+    for (I32 y = min_y; y <= max_y; ++y) {
+      simulation::cells::to_materials(
+          cells + (y - chunk_top) * CHUNK_WIDTH + (min_x - chunk_left),
+          reinterpret_cast<MaterialType*>(_gpu_memory + y * VIEW_WIDTH + min_x),
+          span);
+    }
+
+    return span * (max_y - min_y + 1);
+  }
+
+  // uploads the whole view when full is set, otherwise only what changed
+  // since the last upload
+  U32 _upload_view(bool full) {
+    U32 start_chunk_x = _view_x / CHUNK_WIDTH;
+    U32 start_chunk_y = _view_y / CHUNK_HEIGHT;
+    U32 end_chunk_x   = std::min((_view_x + VIEW_WIDTH - 1) / CHUNK_WIDTH,
+                               _chunks_x_count - 1);
+    U32 end_chunk_y   = std::min((_view_y + VIEW_HEIGHT - 1) / CHUNK_HEIGHT,
+                               _chunks_y_count - 1);
+
+    U32 uploaded_bytes = 0;
+
+    for (U32 chunk_y = start_chunk_y; chunk_y <= end_chunk_y; ++chunk_y) {
+      for (U32 chunk_x = start_chunk_x; chunk_x <= end_chunk_x; ++chunk_x) {
+        auto chunk = _find_chunk(chunk_x, chunk_y);
+
+        if (!chunk) {
+          if (full) {
+            uploaded_bytes += _upload_rect(chunk_x, chunk_y, chunk, FULL_RECT);
+          }
+          continue;
+        }
+
+        auto& rect = full ? FULL_RECT : chunk->gpu_dirty;
+
+        if (_rect_empty(rect)) continue;
+
+        _require(chunk);
+
+        uploaded_bytes += _upload_rect(chunk_x, chunk_y, chunk, rect);
+
+        chunk->gpu_dirty = DirtyRect{};
+      }
+    }
+
+    return uploaded_bytes;
+  }
+
+  // chunk rect around the view, grown by margin chunks and clamped to the
+  // level
+  void _view_chunk_rect(U32 margin, U32 rect[4]) {
+    U32 start_chunk_x = _view_x / CHUNK_WIDTH;
+    U32 start_chunk_y = _view_y / CHUNK_HEIGHT;
+    U32 end_chunk_x   = (_view_x + VIEW_WIDTH - 1) / CHUNK_WIDTH;
+    U32 end_chunk_y   = (_view_y + VIEW_HEIGHT - 1) / CHUNK_HEIGHT;
+
+    rect[0] = start_chunk_x > margin ? start_chunk_x - margin : 0;
+    rect[1] = start_chunk_y > margin ? start_chunk_y - margin : 0;
+    rect[2] = std::min(end_chunk_x + margin, _chunks_x_count - 1);
+    rect[3] = std::min(end_chunk_y + margin, _chunks_y_count - 1);
+  }
+
+  bool _in_chunk_rect(const Chunk* chunk, const U32 rect[4]) {
+    return chunk->x >= rect[0] && chunk->y >= rect[1] && chunk->x <= rect[2] &&
+           chunk->y <= rect[3];
+  }
+
+  // compresses chunks outside the view that slept for DORMANT_TICKS and
+  // drops them from _resident
+  void _compress_dormant() {
+    U32 view_rect[4];
+    _view_chunk_rect(0, view_rect);
+
+    U32 resident_count = 0;
+
+    for (U32 i = 0; i < _resident._size; ++i) {
+      auto chunk = _resident._data[i];
+
+      if (chunk->residency == Residency::RESIDENT && !chunk->awake &&
+          _tick - chunk->slept_at >= DORMANT_TICKS &&
+          !_in_chunk_rect(chunk, view_rect)) {
+        if (_compress(chunk)) {
+          chunk->gpu_dirty = DirtyRect{};
+          continue;
+        }
+
+        chunk->slept_at = _tick;
+      }
+
+      _resident._data[resident_count++] = chunk;
+    }
+
+    _resident._size = resident_count;
+  }
+
+  // finishes page i/o that completed since the last tick, loads chunks the
+  // view moved towards and writes sleeping chunks far from the view to the
+  // page file
+  void _update_residency() {
+    U32 resident_count = 0;
+
+    for (U32 i = 0; i < _resident._size; ++i) {
+      auto chunk = _resident._data[i];
+
+      if (chunk->residency == Residency::STORING &&
+          simulation::pages::done(chunk->io_ticket)) {
+        chunk->residency = Residency::STORED;
+        array::push_back(_free_blocks, chunk->block);
+        chunk->block = nullptr;
+        continue;
+      }
+
+      if (chunk->residency == Residency::LOADING &&
+          simulation::pages::done(chunk->io_ticket)) {
+        chunk->residency  = Residency::RESIDENT;
+        chunk->prefetched = true;
+        _pull_halo(chunk);
+      }
+
+      _resident._data[resident_count++] = chunk;
+    }
+
+    _resident._size = resident_count;
+
+    U32 keep_rect[4];
+    _view_chunk_rect(_residency_radius + _prefetch_ring, keep_rect);
+
+    if (memcmp(keep_rect, _residency_rect, sizeof(keep_rect)) != 0) {
+      memcpy(_residency_rect, keep_rect, sizeof(keep_rect));
+
+      U32 require_rect[4];
+      _view_chunk_rect(_residency_radius, require_rect);
+
+      for (U32 chunk_y = keep_rect[1]; chunk_y <= keep_rect[3]; ++chunk_y) {
+        for (U32 chunk_x = keep_rect[0]; chunk_x <= keep_rect[2]; ++chunk_x) {
+          auto chunk = _find_chunk(chunk_x, chunk_y);
+
+          if (!chunk) continue;
+
+          // still being written out, the block has the cells
+          if (chunk->residency == Residency::STORING) _require(chunk);
+
+          if (chunk->residency != Residency::STORED) continue;
+
+          if (_in_chunk_rect(chunk, require_rect)) {
+            _require(chunk);
+            continue;
+          }
+
+          _attach_block(chunk);
+          chunk->residency = Residency::LOADING;
+          chunk->io_ticket =
+              simulation::pages::read(chunk->page_record, chunk->block);
+
+          ++_stats.pages_read;
+        }
+      }
+    }
+
+    // awake chunks stay resident wherever they are, they sleep eventually
+    for (U32 i = 0; i < _resident._size; ++i) {
+      auto chunk = _resident._data[i];
+
+      if (chunk->residency != Residency::RESIDENT || chunk->awake ||
+          _in_chunk_rect(chunk, keep_rect)) {
+        continue;
+      }
+
+      if (chunk->page_record == U32_MAX) chunk->page_record = _page_records++;
+
+      chunk->residency  = Residency::STORING;
+      chunk->prefetched = false;
+      chunk->gpu_dirty  = DirtyRect{};
+      chunk->io_ticket =
+          simulation::pages::write(chunk->page_record, chunk->block);
+
+      ++_stats.pages_written;
+    }
+
+    _stats.chunks_resident = 0;
+
+    for (U32 i = 0; i < _resident._size; ++i) {
+      if (_resident._data[i]->residency == Residency::RESIDENT) {
+        ++_stats.chunks_resident;
+      }
+    }
+
+    _stats.page_read_ns = simulation::pages::counters().read_ns;
+  }
+
+  // gives the chunk a heat field, cold in both buffers
+  void _heat_up(Chunk* chunk) {
+    if (chunk->heat) return;
+
+    const U32 bytes = 2 * simulation::heat::CELLS * sizeof(F32);
+
+    if (_free_heat._size > 0) {
+      chunk->heat = _free_heat._data[--_free_heat._size];
+      std::fill_n(chunk->heat, 2 * simulation::heat::CELLS, 0.0f);
+    } else {
+      chunk->heat = arena::alloc<F32>(mem_level, bytes);
+    }
+
+    chunk->hashed = false;
+
+    array::push_back(_hot, chunk);
+    _touch(chunk);
+  }
+
+  // drops the chunk's field, the caller takes it out of _hot
+  void _cool_down(Chunk* chunk) {
+    array::push_back(_free_heat, chunk->heat);
+
+    chunk->heat       = nullptr;
+    chunk->hottest    = 0.0f;
+    chunk->heat_edges = BorderChange::NONE;
+    chunk->ignites    = DirtyRect{};
+    chunk->hashed     = false;
+  }
+
+  void _drop_cold_chunks() {
+    U32 hot_count = 0;
+
+    for (U32 i = 0; i < _hot._size; ++i) {
+      if (_hot._data[i]->heat) _hot._data[hot_count++] = _hot._data[i];
+    }
+
+    _hot._size = hot_count;
+  }
+
+  // the field with a border of the heat cells along the neighbours' edges,
+  // cold where a neighbour has no field. the stencil skips the corners
+  void _heat_window(Chunk* chunk, F32* window) {
+    const U32 WIDTH = simulation::heat::WIDTH;
+    const U32 ROW   = WIDTH + 2;
+
+    std::fill_n(window, ROW * ROW, 0.0f);
+
+    auto heat = _heat(chunk);
+
+    for (U32 y = 0; y < WIDTH; ++y) {
+      memcpy(window + (y + 1) * ROW + 1,
+             heat + y * WIDTH,
+             WIDTH * sizeof(F32));
+    }
+
+    for (auto& neighbour : NEIGHBOURS) {
+      if (neighbour.dx && neighbour.dy) continue;
+
+      I32 neighbour_x = chunk->x + neighbour.dx;
+      I32 neighbour_y = chunk->y + neighbour.dy;
+
+      if (!_chunk_in_level(neighbour_x, neighbour_y)) continue;
+
+      auto source = _find_chunk(neighbour_x, neighbour_y);
+
+      if (!source || !source->heat) continue;
+
+      auto source_heat = _heat(source);
+
+      // the neighbour's row or column facing this chunk
+      U32 edge_x   = neighbour.dx > 0 ? 0 : WIDTH - 1;
+      U32 edge_y   = neighbour.dy > 0 ? 0 : WIDTH - 1;
+      U32 window_x = neighbour.dx > 0 ? WIDTH + 1 : 0;
+      U32 window_y = neighbour.dy > 0 ? WIDTH + 1 : 0;
+
+      for (U32 i = 0; i < WIDTH; ++i) {
+        if (neighbour.dx) {
+          window[(i + 1) * ROW + window_x] = source_heat[i * WIDTH + edge_x];
+        } else {
+          window[window_y * ROW + i + 1] = source_heat[edge_y * WIDTH + i];
+        }
+      }
+    }
+  }
+
+  // temperature each heat cell gains from the materials in it this tick
+  void _heat_sources(Chunk* chunk, F32* sources) {
+    const U32 SCALE = simulation::heat::SCALE;
+
+    std::fill_n(sources, simulation::heat::CELLS, 0.0f);
+
+    if (!(chunk->materials & simulation::materials::HEATING)) return;
+
+    auto cells = chunk->cells[chunk->front].data;
+
+    for (U32 y = 0; y < CHUNK_HEIGHT; ++y) {
+      auto row = sources + (y / SCALE) * simulation::heat::WIDTH;
+
+      for (U32 x = 0; x < CHUNK_WIDTH; ++x) {
+        auto material = simulation::cells::material(cells[y * CHUNK_WIDTH + x]);
+
+        row[x / SCALE] +=
+            simulation::materials::rule(material).heat / (SCALE * SCALE);
+      }
+    }
+  }
+
+  void _update_chunk_heat(U32 index) {
+    const U32 WIDTH = simulation::heat::WIDTH;
+    const U32 SCALE = simulation::heat::SCALE;
+    const F32 COLD  = simulation::heat::COLD;
+
+    F32 window[(WIDTH + 2) * (WIDTH + 2)];
+    F32 sources[simulation::heat::CELLS];
+
+    auto chunk = _hot._data[index];
+    auto next  = chunk->heat + (_heat_front ^ 1) * simulation::heat::CELLS;
+
+    _heat_window(chunk, window);
+    _heat_sources(chunk, sources);
+
+    chunk->hottest    = simulation::heat::diffuse(window, sources, next);
+    chunk->heat_edges = BorderChange::NONE;
+    chunk->ignites    = DirtyRect{};
+
+    for (U32 i = 0; i < WIDTH; ++i) {
+      if (next[i] >= COLD) {
+        chunk->heat_edges = chunk->heat_edges | BorderChange::TOP;
+      }
+      if (next[(WIDTH - 1) * WIDTH + i] >= COLD) {
+        chunk->heat_edges = chunk->heat_edges | BorderChange::BOTTOM;
+      }
+      if (next[i * WIDTH] >= COLD) {
+        chunk->heat_edges = chunk->heat_edges | BorderChange::LEFT;
+      }
+      if (next[i * WIDTH + WIDTH - 1] >= COLD) {
+        chunk->heat_edges = chunk->heat_edges | BorderChange::RIGHT;
+      }
+    }
+
+    F32 ignition = simulation::materials::ignition(chunk->materials);
+
+    if (ignition == 0.0f || chunk->hottest < ignition) return;
+
+    for (U32 y = 0; y < WIDTH; ++y) {
+      for (U32 x = 0; x < WIDTH; ++x) {
+        if (next[y * WIDTH + x] < ignition) continue;
+
+        _rect_add(chunk->ignites, x * SCALE, y * SCALE);
+        _rect_add(chunk->ignites, x * SCALE + SCALE - 1, y * SCALE + SCALE - 1);
+      }
+    }
+  }
+
+  // diffuses every heat field, gives the neighbours along warm edges a
+  // field of their own and wakes cells hot enough to catch fire. chunks
+  // without a field are never looked at, a field that cooled off without
+  // anything heating it is dropped
+  void _update_heat() {
+    for (U32 i = 0; i < _awake._size; ++i) {
+      auto chunk = _awake._data[i];
+
+      if (chunk->materials & simulation::materials::HEATING) _heat_up(chunk);
+    }
+
+    for (U32 i = 0; i < _hot._size; ++i) {
+      auto chunk = _hot._data[i];
+
+      if (chunk->materials & simulation::materials::HEATING) _require(chunk);
+    }
+
+    if (_parallel) {
+      jobs::parallel_for(_hot._size, _update_chunk_heat);
+    } else {
+      for (U32 i = 0; i < _hot._size; ++i) {
+        _update_chunk_heat(i);
+      }
+    }
+
+    _heat_front ^= 1;
+
+    for (U32 i = 0; i < _hot._size; ++i) {
+      auto chunk = _hot._data[i];
+
+      chunk->hashed = false;
+      _touch(chunk);
+
+      if (chunk->hottest < simulation::heat::COLD &&
+          !(chunk->materials & simulation::materials::HEATING)) {
+        _cool_down(chunk);
+      }
+    }
+
+    _drop_cold_chunks();
+
+    U32 hot_count = _hot._size;
+
+    for (U32 i = 0; i < hot_count; ++i) {
+      auto chunk = _hot._data[i];
+
+      for (auto& neighbour : NEIGHBOURS) {
+        if (!(chunk->heat_edges & neighbour.border)) continue;
+
+        I32 neighbour_x = chunk->x + neighbour.dx;
+        I32 neighbour_y = chunk->y + neighbour.dy;
+
+        if (!_chunk_in_level(neighbour_x, neighbour_y)) continue;
+
+        // allocated or not, so heat spreads the same however many chunks
+        // earlier ticks happened to touch
+        _heat_up(_get_chunk(neighbour_x, neighbour_y));
+      }
+
+      if (!_rect_empty(chunk->ignites)) {
+        _wake_chunk(chunk->x, chunk->y, chunk->ignites);
+      }
+    }
+
+    _stats.heat_chunks = _hot._size;
+  }
+
+  // labels the chunk again when the rows it reshaped hold other solids
+  // than the last time. runs on the job threads
+  void _label_chunk(U32 index) {
+    auto chunk = _reshaped._data[index];
+
+    simulation::solids::relabel(*chunk->solids,
+                                chunk->cells[chunk->front].data,
+                                chunk->reshaped.min_y,
+                                chunk->reshaped.max_y);
+  }
+
+  // the solids of the chunk at x, y, nullptr past the level's right side
+  // or bottom or where the chunk never held any
+  simulation::solids::Solids* _find_solids(U32 x, U32 y) {
+    if (x >= _chunks_x_count || y >= _chunks_y_count) return nullptr;
+
+    auto chunk = _find_chunk(x, y);
+
+    return chunk ? chunk->solids : nullptr;
+  }
+
+  void _link(Chunk* chunk) {
+    simulation::solids::link(*chunk->solids,
+                             _find_solids(chunk->x + 1, chunk->y),
+                             _find_solids(chunk->x, chunk->y + 1));
+  }
+
+  // turns the regions of the reshaped chunks that no longer reach the
+  // level's sides or bottom into bodies. chunks are labeled on their own
+  // and in parallel, only the reshaped ones, and linked to their
+  // neighbours. solids::update then joins the regions across chunks
+  void _update_bodies() {
+    _stats.chunks_labeled = 0;
+
+    for (U32 i = 0; i < _reshaped._size; ++i) {
+      auto chunk = _reshaped._data[i];
+
+      _require(chunk);
+
+      if (chunk->solids) continue;
+
+      chunk->solids = simulation::solids::add(chunk->x, chunk->y);
+    }
+
+    if (_parallel) {
+      jobs::parallel_for(_reshaped._size, _label_chunk);
+    } else {
+      for (U32 i = 0; i < _reshaped._size; ++i) {
+        _label_chunk(i);
+      }
+    }
+
+    _relabeled._size = 0;
+
+    for (U32 i = 0; i < _reshaped._size; ++i) {
+      auto chunk = _reshaped._data[i];
+
+      chunk->reshaped = DirtyRect{};
+
+      if (!chunk->solids->relabeled) continue;
+
+      array::push_back(_relabeled, chunk->solids);
+
+      // the links on all four sides of the chunk
+      _link(chunk);
+
+      if (chunk->x > 0) {
+        auto left = _find_chunk(chunk->x - 1, chunk->y);
+        if (left && left->solids) _link(left);
+      }
+
+      if (chunk->y > 0) {
+        auto above = _find_chunk(chunk->x, chunk->y - 1);
+        if (above && above->solids) _link(above);
+      }
+    }
+
+    _reshaped._size = 0;
+
+    simulation::solids::update(_relabeled._data,
+                               _relabeled._size,
+                               _chunks_x_count,
+                               _chunks_y_count);
+
+    _stats.chunks_labeled = _relabeled._size;
+    _stats.solid_chunks   = simulation::solids::chunk_count();
+    _stats.bodies         = simulation::solids::body_count();
+  }
+
+  U32 _record_bytes() {
+    U32 bytes = sizeof(RecordHead) + CHUNK_WIDTH_HEIGHT * sizeof(Cell);
+
+#ifndef SIMULATION_PACKED_CELLS
+    bytes += 3 * CHUNK_WIDTH_HEIGHT;
+#endif
+
+    return bytes;
+  }
+
+  // copies the chunk's front buffer, planes and heat into a new record of
+  // the newest checkpoint
+  void _record(Chunk* chunk) {
+    _require(chunk);
+
+    auto record =
+        simulation::checkpoints::record(chunk->index, chunk->heat != nullptr);
+
+    RecordHead head{.active = chunk->active, .materials = chunk->materials};
+
+    U8* out   = record->data;
+    U8  front = chunk->front;
+
+    memcpy(out, &head, sizeof(head));
+    out += sizeof(head);
+    memcpy(out, chunk->cells[front].data, CHUNK_WIDTH_HEIGHT * sizeof(Cell));
+#ifndef SIMULATION_PACKED_CELLS
+    out += CHUNK_WIDTH_HEIGHT * sizeof(Cell);
+    memcpy(out, chunk->velocity_x[front].data, CHUNK_WIDTH_HEIGHT);
+    out += CHUNK_WIDTH_HEIGHT;
+    memcpy(out, chunk->velocity_y[front].data, CHUNK_WIDTH_HEIGHT);
+    out += CHUNK_WIDTH_HEIGHT;
+    memcpy(out, chunk->flags[front].data, CHUNK_WIDTH_HEIGHT);
+#endif
+
+    if (record->heated) {
+      memcpy(record->heat,
+             _heat(chunk),
+             simulation::heat::CELLS * sizeof(F32));
+    }
+  }
+
+  // puts the chunk back the way record saw it, or to AIR when it did not
+  // exist yet. the halo is pulled again once every chunk is restored, and
+  // chunks that lost their heat field leave _hot then
+  void _restore(Chunk* chunk, const simulation::checkpoints::Record* record) {
+    _require(chunk);
+
+    if (record && record->heated) {
+      _heat_up(chunk);
+      memcpy(_heat(chunk),
+             record->heat,
+             simulation::heat::CELLS * sizeof(F32));
+    } else if (chunk->heat) {
+      _cool_down(chunk);
+    }
+
+    U8 front = chunk->front;
+
+    chunk->dirty          = DirtyRect{};
+    chunk->busy           = DirtyRect{};
+    chunk->border_changes = BorderChange::NONE;
+    chunk->materials_seen = 0;
+    chunk->slept_at       = _tick;
+    chunk->hashed         = false;
+
+    if (!record) {
+      std::fill_n(chunk->cells[front].data,
+                  CHUNK_WIDTH_HEIGHT,
+                  simulation::cells::make(MaterialType::AIR));
+#ifndef SIMULATION_PACKED_CELLS
+      memset(chunk->velocity_x[front].data, 0, CHUNK_WIDTH_HEIGHT);
+      memset(chunk->velocity_y[front].data, 0, CHUNK_WIDTH_HEIGHT);
+      memset(chunk->flags[front].data, 0, CHUNK_WIDTH_HEIGHT);
+#endif
+
+      chunk->active    = DirtyRect{};
+      chunk->materials = simulation::materials::bit(MaterialType::AIR);
+      _reshape(chunk, FULL_RECT);
+      return;
+    }
+
+    const U8* in = record->data;
+
+    RecordHead head;
+    memcpy(&head, in, sizeof(head));
+    in += sizeof(head);
+
+    memcpy(chunk->cells[front].data, in, CHUNK_WIDTH_HEIGHT * sizeof(Cell));
+#ifndef SIMULATION_PACKED_CELLS
+    in += CHUNK_WIDTH_HEIGHT * sizeof(Cell);
+    memcpy(chunk->velocity_x[front].data, in, CHUNK_WIDTH_HEIGHT);
+    in += CHUNK_WIDTH_HEIGHT;
+    memcpy(chunk->velocity_y[front].data, in, CHUNK_WIDTH_HEIGHT);
+    in += CHUNK_WIDTH_HEIGHT;
+    memcpy(chunk->flags[front].data, in, CHUNK_WIDTH_HEIGHT);
+#endif
+
+    chunk->active    = head.active;
+    chunk->materials = head.materials;
+    _reshape(chunk, FULL_RECT);
+  }
+
+  void _init_gpu_memory() {
+    if (!_gpu_memory) return;
+
+    memset(_gpu_memory,
+           static_cast<U8>(MaterialType::BORDER),
+           VIEW_WIDTH * VIEW_HEIGHT);
+
+    _upload_view(true);
+  }
+
+  U32 _update_gpu_memory() {
+    if (!_gpu_memory) return 0;
+
+    bool full       = _gpu_view_moved;
+    _gpu_view_moved = false;
+
+    return _upload_view(full);
+  }
+}
+
+void print_sim() {
+  if (!_gpu_memory) return;
+
+  U32 per_line_count = 0;
+  U32 line_count     = 0;
+
+  for (U32 i = 0; i < 192 * 108; ++i) {
+    printf("%c",
+           _gpu_memory[i] == static_cast<U8>(MaterialType::AIR) ? '.' : '#');
+    if (++per_line_count == 192) {
+      printf(" - %d\n", line_count++);
+      per_line_count = 0;
+    }
+  }
+}
+
+void simulation::init(
+    U32 view_x, U32 view_y, U32 level_width, U32 level_height, U8* gpu_memory) {
+  assert(level_width % CHUNK_WIDTH == 0 &&
+         "Level width must be a multiple of CHUNK_WIDTH");
+  assert(level_height % CHUNK_HEIGHT == 0 &&
+         "Level height must be a multiple of CHUNK_HEIGHT");
+
+  _view_x         = view_x;
+  _view_y         = view_y;
+  _gpu_view_moved = false;
+
+  _chunks_x_count = level_width / CHUNK_WIDTH;
+  _chunks_y_count = level_height / CHUNK_HEIGHT;
+
+  _pages       = hashmap::init64<ChunkPage*>(mem_level, 1024);
+  _awake       = array::init<Chunk*>(mem_level, 1024);
+  _chunks      = array::init<Chunk*>(mem_level, 1024);
+  _resident    = array::init<Chunk*>(mem_level, 1024);
+  _free_blocks = array::init<U8*>(mem_level, 64);
+  _packing     = arena::alloc(mem_level, _packing_bytes());
+  _particles   = particles::init(mem_level, MAX_PARTICLES);
+  _pushed      = array::init<Chunk*>(mem_level, 64);
+  _flights     = arena::alloc<Flight>(mem_level, MAX_PARTICLES);
+  _hot         = array::init<Chunk*>(mem_level, 64);
+  _reshaped    = array::init<Chunk*>(mem_level, 64);
+  _relabeled   = array::init<simulation::solids::Solids*>(mem_level, 64);
+  _free_heat   = array::init<F32*>(mem_level, 64);
+  _heat_front  = 0;
+  _tick        = 0;
+  _accumulator = 0.0;
+
+  simulation::solids::init(mem_level);
+
+  // records point at chunks of the level arena, which the caller just reset
+  simulation::checkpoints::stop();
+
+  simulation::pages::close();
+  _streaming    = false;
+  _page_records = 0;
+
+  _stats = simulation::Stats{};
+
+  _gpu_memory = gpu_memory;
+  _init_gpu_memory();
+}
+
+void simulation::simulate() {
+  auto started = std::chrono::steady_clock::now();
+
+  _launch_cells();
+  _update_particles();
+
+  _stats.particle_ns = _elapsed_ns(started);
+
+  if (_parallel) {
+    jobs::parallel_for(_awake._size, _update_awake_chunk);
+    jobs::parallel_for(_awake._size, _push_awake_halos);
+  } else {
+    for (U32 i = 0; i < _awake._size; ++i) {
+      _update_awake_chunk(i);
+    }
+    for (U32 i = 0; i < _awake._size; ++i) {
+      _push_awake_halos(i);
+    }
+  }
+
+  _schedule_chunks();
+
+  started = std::chrono::steady_clock::now();
+
+  _update_heat();
+
+  _stats.heat_ns      = _elapsed_ns(started);
+  _stats.chunks_awake = _awake._size;
+
+  started = std::chrono::steady_clock::now();
+
+  _update_bodies();
+
+  _stats.label_ns = _elapsed_ns(started);
+
+  ++_tick;
+
+  _compress_dormant();
+
+  if (_streaming) _update_residency();
+
+  _stats.gpu_bytes_uploaded = _update_gpu_memory();
+
+  // print_sim();
+}
+
+U32 simulation::advance(F64 dt) {
+  _accumulator += dt;
+
+  U32 ticks = 0;
+
+  while (_accumulator >= _tick_seconds) {
+    if (ticks == MAX_TICKS_PER_ADVANCE) {
+      _accumulator = 0.0;
+      break;
+    }
+
+    simulate();
+
+    _accumulator -= _tick_seconds;
+    ++ticks;
+  }
+
+  return ticks;
+}
+
+void simulation::set_tick_rate(U32 ticks_per_second) {
+  assert(ticks_per_second > 0 && "Tick rate must be positive");
+
+  _tick_seconds = 1.0 / ticks_per_second;
+}
+
+U32 simulation::tick() { return _tick; }
+
+U64 simulation::state_hash() {
+  U64 hash = 0;
+
+  for (U32 i = 0; i < _chunks._size; ++i) {
+    auto chunk = _chunks._data[i];
+
+    if (!chunk->hashed) {
+      _require(chunk);
+
+      U32 position[2] = {chunk->x, chunk->y};
+
+      chunk->hash = fnv_64a_buf(position, sizeof(position), FNV1A_64_INIT);
+      chunk->hash = fnv_64a_buf(chunk->cells[chunk->front].data,
+                                CHUNK_WIDTH_HEIGHT * sizeof(Cell),
+                                chunk->hash);
+      chunk->hashed = true;
+
+      if (chunk->heat) {
+        chunk->hash = fnv_64a_buf(
+            _heat(chunk), heat::CELLS * sizeof(F32), chunk->hash);
+      }
+
+      // a chunk left all AIR by a rollback hashes like one never allocated
+      if (!chunk->heat &&
+          _scan_materials(chunk) == materials::bit(MaterialType::AIR)) {
+        chunk->hash = 0;
+      }
+    }
+
+    hash ^= chunk->hash;
+  }
+
+  return hash ^ particles::hash(_particles);
+}
+
+void simulation::set_checkpoints(ArenaHandle arena, U32 count) {
+  checkpoints::start(arena, count, _record_bytes());
+}
+
+U32 simulation::checkpoint() {
+  U32   id         = checkpoints::take(_tick, _chunks._size, _particles);
+  auto& checkpoint = checkpoints::get(id);
+
+  for (U32 i = 0; i < _awake._size; ++i) {
+    array::push_back(checkpoint.awake, _awake._data[i]->index);
+  }
+
+  auto& touched = checkpoints::touched();
+
+  for (U32 i = 0; i < touched._size; ++i) {
+    _record(_chunks._data[touched._data[i]]);
+  }
+
+  _stats.checkpoint_chunks = touched._size;
+  _stats.checkpoint_bytes  = checkpoints::bytes();
+
+  checkpoints::untouch();
+
+  return id;
+}
+
+bool simulation::rollback(U32 id) {
+  auto checkpoint = checkpoints::rollback(id);
+
+  if (!checkpoint) return false;
+
+  _tick = checkpoint->tick;
+
+  auto& touched = checkpoints::touched();
+
+  for (U32 i = 0; i < touched._size; ++i) {
+    auto chunk = _chunks._data[touched._data[i]];
+
+    _restore(chunk, checkpoints::newest(chunk->index));
+
+    chunk->awake = false;
+  }
+
+  for (U32 i = 0; i < _awake._size; ++i) {
+    _awake._data[i]->awake = false;
+  }
+
+  _awake._size = 0;
+
+  for (U32 i = 0; i < checkpoint->awake._size; ++i) {
+    auto chunk = _chunks._data[checkpoint->awake._data[i]];
+
+    chunk->awake = true;
+    array::push_back(_awake, chunk);
+  }
+
+  // the halos around restored chunks hold cells of the rolled back ticks
+  for (U32 i = 0; i < touched._size; ++i) {
+    auto chunk = _chunks._data[touched._data[i]];
+
+    _pull_halo(chunk);
+
+    for (auto& neighbour : NEIGHBOURS) {
+      I32 neighbour_x = chunk->x + neighbour.dx;
+      I32 neighbour_y = chunk->y + neighbour.dy;
+
+      if (!_chunk_in_level(neighbour_x, neighbour_y)) continue;
+
+      auto target = _find_chunk(neighbour_x, neighbour_y);
+
+      if (!target) continue;
+
+      _require(target);
+      _copy_band(chunk, target, neighbour.dx, neighbour.dy);
+    }
+  }
+
+  checkpoints::untouch();
+  _gpu_view_moved = true;
+
+  particles::copy(checkpoint->particles, _particles);
+
+  _drop_cold_chunks();
+
+  // pushes made since the checkpoint are gone with their chunks
+  for (U32 i = 0; i < _pushed._size; ++i) {
+    _pushed._data[i]->pushed = DirtyRect{};
+  }
+
+  _pushed._size = 0;
+
+  _stats.checkpoint_bytes = checkpoints::bytes();
+
+  return true;
+}
+
+bool simulation::set_streaming(const char* page_file, U32 radius, U32 ring) {
+  simulation::pages::close();
+
+  _streaming = simulation::pages::open(page_file, chunk_bytes());
+
+  if (!_streaming) {
+    printf("Chunk streaming disabled, can't open %s\n", page_file);
+    return false;
+  }
+
+  _residency_radius = radius;
+  _prefetch_ring    = ring;
+  _page_records     = 0;
+  std::fill_n(_residency_rect, 4, U32_MAX);
+
+  _stats.page_hits     = 0;
+  _stats.page_misses   = 0;
+  _stats.pages_read    = 0;
+  _stats.pages_written = 0;
+  _stats.page_read_ns  = 0;
+  _stats.page_stall_ns = 0;
+
+  return true;
+}
+
+void simulation::set_parallel(bool parallel) { _parallel = parallel; }
+
+void simulation::set_kernel(Kernel kernel) {
+  _kernel   = kernel;
+  _fall_row = kernels::fall_row(kernel);
+}
+
+simulation::Kernel simulation::kernel() { return _kernel; }
+
+const simulation::Stats& simulation::stats() { return _stats; }
+
+U32 simulation::chunk_bytes() {
+  U32 bytes = (2 * CHUNK_WIDTH_HEIGHT + HALO_SIZE) * sizeof(Cell);
+
+#ifndef SIMULATION_PACKED_CELLS
+  bytes += 2 * 3 * CHUNK_WIDTH_HEIGHT; // velocity_x, velocity_y, flags
+#endif
+
+  return bytes;
+}
+
+void simulation::set_view(U32 x, U32 y) {
+  if (x == _view_x && y == _view_y) return;
+
+  _view_x         = x;
+  _view_y         = y;
+  _gpu_view_moved = true;
+}
+
+void simulation::add_cell(U32 x, U32 y, MaterialType type) {
+  if (replay::recording()) replay::input(_tick, x, y, type);
+
+  _place_cell(x, y, type);
+}
+
+void simulation::push_cell(U32 x, U32 y, I8 velocity_x, I8 velocity_y) {
+  assert(velocity_x >= -16 && velocity_x <= 15 && velocity_y >= -16 &&
+         velocity_y <= 15 && "Cell velocity out of range");
+
+  if (replay::recording()) replay::push(_tick, x, y, velocity_x, velocity_y);
+
+  auto chunk = _get_chunk(x / CHUNK_WIDTH, y / CHUNK_HEIGHT);
+
+  _require(chunk);
+  _touch(chunk);
+
+  U32 local_x = x % CHUNK_WIDTH;
+  U32 local_y = y % CHUNK_HEIGHT;
+
+  _set_velocity(
+      chunk, local_y * CHUNK_WIDTH + local_x, velocity_x, velocity_y);
+
+  if (_rect_empty(chunk->pushed)) array::push_back(_pushed, chunk);
+
+  _rect_add(chunk->pushed, local_x, local_y);
+  chunk->hashed = false;
+}
+
+U32 simulation::body_count() { return simulation::solids::body_count(); }
+
+const simulation::Body* simulation::bodies() {
+  return simulation::solids::bodies();
+}
+
+MaterialType simulation::cell(U32 x, U32 y) {
+  auto chunk = _find_chunk(x / CHUNK_WIDTH, y / CHUNK_HEIGHT);
+
+  if (!chunk) return MaterialType::AIR;
+
+  _require(chunk);
 
   U32 local_x = x % CHUNK_WIDTH;
   U32 local_y = y % CHUNK_HEIGHT;
 
-  chunk->materials[current_buffer_index].data[local_y * CHUNK_WIDTH + local_x] =
-      type;
+  return cells::material(
+      chunk->cells[chunk->front].data[local_y * CHUNK_WIDTH + local_x]);
 }
@@ -1,5 +1,6 @@
 #pragma once
 
+#include "handles.h"
 #include "types.h"
 
 enum class MaterialType : U8 {
@@ -13,12 +14,143 @@ enum class MaterialType : U8 {
 };
 
 namespace simulation {
+  // row kernels, ordered from narrowest to widest
+  enum class Kernel : U8 {
+    SCALAR,
+    SSE2,
+    AVX2,
+    AVX512,
+  };
+
+  // a point of a body outline, in cells from the level's top left
+  struct Vertex {
+    F32 x;
+    F32 y;
+  };
+
+  // a region of 4-connected solid cells that no longer touches the level's
+  // sides or bottom. its cells stay in the grid, the body describes them for
+  // whatever takes them over
+  struct Body {
+    // cell bounds, inclusive, and the number of cells in them
+    U32 min_x;
+    U32 min_y;
+    U32 max_x;
+    U32 max_y;
+    U32 cells;
+
+    // closed outlines through the edges between the body and the cells
+    // around it, found by marching squares. loop i ends before
+    // loop_ends[i]. the body is on the right of every loop when y points
+    // down, so holes wind the other way than the outside
+    const Vertex* points;
+    const U32*    loop_ends;
+    U32           loop_count;
+  };
+
+  struct Stats {
+    U32 chunks_updated = 0; // chunks run by the last simulate
+    U32 chunks_awake   = 0; // chunks scheduled for the next simulate
+
+    U32 chunks_allocated = 0; // chunks touched since init, never freed
+
+    U32 gpu_bytes_uploaded = 0; // material bytes copied by the last simulate
+
+    // chunk streaming, counted since set_streaming
+    U32 chunks_resident = 0; // chunks whose cells are in memory
+    U32 page_hits       = 0; // prefetched chunks that were needed
+    U32 page_misses     = 0; // chunks needed before their read finished
+    U32 pages_read      = 0; // reads issued, queued or on demand
+    U32 pages_written   = 0; // writes issued
+    U64 page_read_ns    = 0; // summed latency of background reads
+    U64 page_stall_ns   = 0; // time simulate waited on the page file
+
+    // sleeping chunks are run length coded after a while, and decoded when
+    // something touches them again
+    U32 chunks_compressed   = 0; // chunks currently coded
+    U32 compressed_bytes    = 0; // their coded size, chunk_bytes() each
+    U32 chunks_decompressed = 0; // since init
+    U64 decompress_ns       = 0; // summed over chunks_decompressed
+
+    U32 particles          = 0; // in flight after the last simulate
+    U32 particles_launched = 0; // cells the last simulate turned into them
+    U32 particles_landed   = 0; // and the particles it turned back
+    U64 particle_ns        = 0; // time the last simulate spent on them
+
+    U32 heat_chunks = 0; // chunks with a heat field
+    U64 heat_ns     = 0; // time the last simulate spent on heat
+
+    U32 solid_chunks   = 0; // chunks holding solid cells, as of the last label
+    U32 chunks_labeled = 0; // chunks whose solids the last simulate relabeled
+    U32 bodies         = 0; // regions the last simulate cut loose
+    U64 label_ns       = 0; // time the last simulate spent on them
+
+    U32 checkpoint_chunks = 0; // chunks the last checkpoint copied
+    U32 checkpoint_bytes  = 0; // cells held by every checkpoint in the ring
+  };
+
+  // level_width and level_height are in cells and multiples of the chunk
+  // size. chunks are allocated from the level arena as they are touched
   void init(U32 view_x,
             U32 view_y,
             U32 level_width,
             U32 level_height,
             U8* gpu_memory);
   void simulate();
+
+  // runs simulate at a fixed tick rate, as many times as dt and the time
+  // left over from earlier calls cover. returns the ticks run
+  U32  advance(F64 dt);
+  void set_tick_rate(U32 ticks_per_second); // 60 by default
+  U32  tick();                              // ticks simulated since init
+
+  // hash of every allocated chunk's cells. equal runs give equal hashes
+  // after every tick, only chunks changed since the last call are rehashed
+  U64 state_hash();
+
+  // keeps the last count checkpoints in memory from arena. call after init,
+  // which turns checkpoints off
+  void set_checkpoints(ArenaHandle arena, U32 count);
+
+  // saves the world and returns its id. the first checkpoint copies every
+  // chunk, the ones after it only chunks changed since the previous one
+  U32 checkpoint();
+
+  // puts the world and tick back the way checkpoint id saw them and drops
+  // the checkpoints taken after it. costs about as much as the chunks
+  // changed since. false when id has left the ring
+  bool rollback(U32 id);
+
+  // pages the cells of sleeping chunks further than radius + ring chunks
+  // from the view out to page_file, and reads them back in the background
+  // once the view is within ring chunks of them. call after init, which
+  // turns streaming off
+  bool set_streaming(const char* page_file, U32 radius, U32 ring);
+
+  // serial and parallel chunk updates give bit-identical results
+  void set_parallel(bool parallel);
+  // defaults to the widest kernel the cpu supports
+  void   set_kernel(Kernel kernel);
+  Kernel kernel();
   void set_view(U32 x, U32 y);
   void add_cell(U32 x, U32 y, MaterialType type);
+
+  // gives the cell a velocity of -16 to 15 quarter cells per tick. cells
+  // that can move leave the grid at the start of the next simulate and fly
+  // as particles until they hit something. a checkpoint taken in between
+  // does not keep the push
+  void push_cell(U32 x, U32 y, I8 velocity_x, I8 velocity_y);
+
+  MaterialType cell(U32 x, U32 y);
+
+  // the bodies the last simulate found, valid until the next simulate. only
+  // regions with cells in chunks whose solids changed are looked at, so a
+  // region that stays loose is not found again until it changes
+  U32         body_count();
+  const Body* bodies();
+
+  const Stats& stats();
+
+  // level arena bytes a chunk takes, depends on the cell layout
+  U32 chunk_bytes();
 }
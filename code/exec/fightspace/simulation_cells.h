@@ -0,0 +1,68 @@
+#pragma once
+
+#include "exec/fightspace/simulation.h"
+#include "types.h"
+
+#include <cstring>
+
+// a cell is what chunk buffers and halos store per position. by default it
+// is just the MaterialType and velocity and flags live in planes of their
+// own. with SIMULATION_PACKED_CELLS a cell is one 16 bit word:
+//
+//   bits 0-3   material
+//   bits 4-8   velocity x, signed
+//   bits 9-13  velocity y, signed
+//   bits 14-15 free
+//
+// which halves a chunk's footprint and keeps everything a cell update
+// touches in one cache line per 32 cells
+namespace simulation::cells {
+#ifdef SIMULATION_PACKED_CELLS
+  typedef U16 Cell;
+
+  const U16 MATERIAL_MASK    = 0x000f;
+  const U16 VELOCITY_MASK    = 0x001f;
+  const U8  VELOCITY_X_SHIFT = 4;
+  const U8  VELOCITY_Y_SHIFT = 9;
+
+  inline MaterialType material(Cell cell) {
+    return static_cast<MaterialType>(cell & MATERIAL_MASK);
+  }
+
+  inline Cell make(MaterialType material) {
+    return static_cast<Cell>(material);
+  }
+
+  // sign extends a 5 bit velocity field
+  inline I8 _velocity(Cell cell, U8 shift) {
+    return static_cast<I8>(((cell >> shift) & VELOCITY_MASK) << 3) >> 3;
+  }
+
+  inline I8 velocity_x(Cell cell) { return _velocity(cell, VELOCITY_X_SHIFT); }
+  inline I8 velocity_y(Cell cell) { return _velocity(cell, VELOCITY_Y_SHIFT); }
+
+  inline Cell with_velocity(Cell cell, I8 velocity_x, I8 velocity_y) {
+    return static_cast<Cell>(
+        (cell & MATERIAL_MASK) |
+        ((velocity_x & VELOCITY_MASK) << VELOCITY_X_SHIFT) |
+        ((velocity_y & VELOCITY_MASK) << VELOCITY_Y_SHIFT));
+  }
+
+  // the material plane the gpu reads, written out from count cells
+  inline void to_materials(const Cell* cells, MaterialType* out, U32 count) {
+    for (U32 i = 0; i < count; ++i) {
+      out[i] = static_cast<MaterialType>(cells[i] & MATERIAL_MASK);
+    }
+  }
+#else
+  typedef MaterialType Cell;
+
+  inline MaterialType material(Cell cell) { return cell; }
+
+  inline Cell make(MaterialType material) { return material; }
+
+  inline void to_materials(const Cell* cells, MaterialType* out, U32 count) {
+    memcpy(out, cells, count);
+  }
+#endif
+}
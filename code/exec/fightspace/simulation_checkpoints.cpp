@@ -0,0 +1,232 @@
+#include "simulation_checkpoints.h"
+
+#include "arena.h"
+#include "ds_array_dynamic.h"
+#include "simulation_heat.h"
+#include "types.h"
+
+#include <cassert>
+
+namespace {
+  using simulation::checkpoints::Checkpoint;
+  using simulation::checkpoints::Record;
+
+  ArenaHandle _arena;
+  U32         _record_bytes = 0;
+
+  // slot id % size holds checkpoint id. ids _first to _next - 1 are still
+  // in the ring, none while it is empty
+  DynamicArray<Checkpoint> _ring;
+  U32                      _first = 0;
+  U32                      _next  = 0;
+
+  // per chunk its newest record and whether it is listed in _touched
+  DynamicArray<Record*> _newest;
+  DynamicArray<bool>    _is_touched;
+  DynamicArray<U32>     _touched;
+
+  Record* _free_records = nullptr;
+  U32     _record_count = 0;
+
+  Checkpoint& _slot(U32 id) { return _ring._data[id % _ring._size]; }
+
+  void _free_record(Record* record) {
+    record->prev  = _free_records;
+    _free_records = record;
+    --_record_count;
+  }
+
+  // drops the oldest checkpoint. a record the next checkpoint replaced goes
+  // back to the free list, the others still describe their chunk and move
+  // into the next checkpoint. with a ring of one that is the checkpoint
+  // being taken, in the same slot
+  void _drop_oldest() {
+    U32   oldest = _first++;
+    auto& from   = _slot(oldest);
+    auto& into   = _slot(_first);
+    U32   kept   = 0;
+
+    for (U32 i = 0; i < from.records._size; ++i) {
+      auto record = from.records._data[i];
+      auto newest = _newest._data[record->chunk];
+
+      // the oldest record is last in the chain
+      auto newer = newest == record ? nullptr : newest;
+
+      while (newer && newer->prev != record) {
+        newer = newer->prev;
+      }
+
+      if (newer && newer->checkpoint == _first) {
+        newer->prev = nullptr;
+        _free_record(record);
+        continue;
+      }
+
+      if (&into == &from) {
+        from.records._data[kept++] = record;
+      } else {
+        array::push_back(into.records, record);
+      }
+    }
+
+    from.records._size = kept;
+  }
+}
+
+void simulation::checkpoints::start(ArenaHandle arena,
+                                    U32         count,
+                                    U32         record_bytes) {
+  assert(count > 0 && "Keep at least one checkpoint");
+
+  _arena        = arena;
+  _record_bytes = record_bytes;
+  _ring         = array::init<Checkpoint>(arena, count, count);
+  _first        = 0;
+  _next         = 0;
+  _newest       = array::init<Record*>(arena, 1024);
+  _is_touched   = array::init<bool>(arena, 1024);
+  _touched      = array::init<U32>(arena, 1024);
+  _free_records = nullptr;
+  _record_count = 0;
+
+  for (U32 i = 0; i < count; ++i) {
+    _ring._data[i] = Checkpoint{
+        .awake   = array::init<U32>(arena, 1024),
+        .records = array::init<Record*>(arena, 1024),
+    };
+  }
+}
+
+void simulation::checkpoints::stop() {
+  _ring         = DynamicArray<Checkpoint>{};
+  _newest       = DynamicArray<Record*>{};
+  _is_touched   = DynamicArray<bool>{};
+  _touched      = DynamicArray<U32>{};
+  _free_records = nullptr;
+  _record_count = 0;
+}
+
+void simulation::checkpoints::touch(U32 chunk) {
+  if (_ring._size == 0) return;
+
+  if (chunk >= _newest._size) {
+    array::resize(_newest, chunk + 1);
+    array::resize(_is_touched, chunk + 1);
+  }
+
+  if (_is_touched._data[chunk]) return;
+
+  _is_touched._data[chunk] = true;
+  array::push_back(_touched, chunk);
+}
+
+const DynamicArray<U32>& simulation::checkpoints::touched() {
+  return _touched;
+}
+
+void simulation::checkpoints::untouch() {
+  for (U32 i = 0; i < _touched._size; ++i) {
+    _is_touched._data[_touched._data[i]] = false;
+  }
+
+  _touched._size = 0;
+}
+
+U32 simulation::checkpoints::take(U32                    tick,
+                                  U32                    chunk_count,
+                                  const particles::Pool& particles) {
+  assert(_ring._size > 0 && "Call set_checkpoints first");
+
+  bool first = _first == _next;
+
+  if (_next - _first == _ring._size) _drop_oldest();
+
+  U32   id         = _next++;
+  auto& checkpoint = _slot(id);
+
+  checkpoint.tick        = tick;
+  checkpoint.awake._size = 0;
+
+  if (checkpoint.particles.capacity < particles.count) {
+    checkpoint.particles = particles::init(_arena, particles.capacity);
+  }
+
+  particles::copy(particles, checkpoint.particles);
+
+  if (first) {
+    for (U32 chunk = 0; chunk < chunk_count; ++chunk) {
+      touch(chunk);
+    }
+  }
+
+  return id;
+}
+
+Checkpoint& simulation::checkpoints::get(U32 id) { return _slot(id); }
+
+Record* simulation::checkpoints::record(U32 chunk, bool heated) {
+  auto record = _free_records;
+
+  if (record) {
+    _free_records = record->prev;
+  } else {
+    record       = arena::alloc<Record>(_arena, sizeof(Record));
+    record->data = arena::alloc_uninit(_arena, _record_bytes);
+  }
+
+  if (heated && !record->heat) {
+    record->heat =
+        arena::alloc_uninit<F32>(_arena, heat::CELLS * sizeof(F32));
+  }
+
+  U32 id = _next - 1;
+
+  record->chunk      = chunk;
+  record->checkpoint = id;
+  record->prev       = _newest._data[chunk];
+  record->heated     = heated;
+
+  _newest._data[chunk] = record;
+  ++_record_count;
+
+  array::push_back(_slot(id).records, record);
+
+  return record;
+}
+
+Checkpoint* simulation::checkpoints::rollback(U32 id) {
+  if (id < _first || id >= _next) return nullptr;
+
+  // chunks recorded by a later checkpoint changed since id, as did the
+  // ones touched since the last checkpoint
+  for (U32 later = id + 1; later < _next; ++later) {
+    auto& records = _slot(later).records;
+
+    for (U32 i = 0; i < records._size; ++i) {
+      touch(records._data[i]->chunk);
+    }
+
+    records._size = 0;
+  }
+
+  _next = id + 1;
+
+  for (U32 i = 0; i < _touched._size; ++i) {
+    auto& newest = _newest._data[_touched._data[i]];
+
+    while (newest && newest->checkpoint > id) {
+      auto record = newest;
+      newest      = record->prev;
+      _free_record(record);
+    }
+  }
+
+  return &_slot(id);
+}
+
+const Record* simulation::checkpoints::newest(U32 chunk) {
+  return chunk < _newest._size ? _newest._data[chunk] : nullptr;
+}
+
+U32 simulation::checkpoints::bytes() { return _record_count * _record_bytes; }
@@ -0,0 +1,71 @@
+#pragma once
+
+#include "ds_array_dynamic.h"
+#include "exec/fightspace/simulation_particles.h"
+#include "handles.h"
+#include "types.h"
+
+// a ring of the last few checkpoints of the world. the first checkpoint
+// records every chunk, the ones after only the chunks touched since the
+// checkpoint before. a chunk a checkpoint did not record is the same as in
+// its newest older record. chunks are their index in the order the
+// simulation allocated them, what a record holds of one is up to it
+namespace simulation::checkpoints {
+  struct Record {
+    U32     chunk;
+    U32     checkpoint;
+    Record* prev; // the chunk's record in an older checkpoint
+
+    // record_bytes the simulation fills in, and the chunk's front heat
+    // field when heated is set
+    U8*  data;
+    bool heated;
+    F32* heat;
+  };
+
+  struct Checkpoint {
+    U32                   tick;
+    DynamicArray<U32>     awake;
+    particles::Pool       particles;
+    DynamicArray<Record*> records;
+  };
+
+  // keeps the last count checkpoints in memory from arena, records of
+  // record_bytes each. forgets the checkpoints taken so far
+  void start(ArenaHandle arena, U32 count, U32 record_bytes);
+
+  // forgets the checkpoints and takes no more until the next start, for
+  // when the arena they are in goes away
+  void stop();
+
+  // the chunk changed since the last checkpoint, which records it. does
+  // nothing while stopped
+  void touch(U32 chunk);
+
+  // the chunks touched since the last checkpoint or rollback, untouch
+  // forgets them
+  const DynamicArray<U32>& touched();
+  void                     untouch();
+
+  // starts the checkpoint of tick and returns its id, dropping the oldest
+  // one when the ring is full. the first checkpoint touches every chunk
+  // below chunk_count. record the touched chunks into it next
+  U32 take(U32 tick, U32 chunk_count, const particles::Pool& particles);
+
+  Checkpoint& get(U32 id);
+
+  // a new record of the chunk in the newest checkpoint, with heat to copy
+  // into when heated
+  Record* record(U32 chunk, bool heated);
+
+  // drops the checkpoints taken after id and touches the chunks they
+  // recorded, whose newest record is then the one id sees. nullptr when id
+  // is no longer in the ring
+  Checkpoint* rollback(U32 id);
+
+  // nullptr when no checkpoint recorded the chunk
+  const Record* newest(U32 chunk);
+
+  // held by every record in the ring
+  U32 bytes();
+}
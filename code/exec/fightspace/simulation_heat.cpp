@@ -0,0 +1,33 @@
+#include "simulation_heat.h"
+
+#include "types.h"
+
+#include <algorithm>
+
+F32 simulation::heat::diffuse(const F32* window, const F32* sources, F32* out) {
+  const U32 ROW = WIDTH + 2;
+
+  F32 hottest = 0.0f;
+
+  // rows are WIDTH floats without dependencies between them, the compiler
+  // turns the inner loop into vector code
+  for (U32 y = 0; y < WIDTH; ++y) {
+    const F32* above  = window + y * ROW + 1;
+    const F32* row    = above + ROW;
+    const F32* below  = row + ROW;
+    const F32* source = sources + y * WIDTH;
+    F32*       next   = out + y * WIDTH;
+
+    for (I32 x = 0; x < WIDTH; ++x) {
+      F32 flow = above[x] + below[x] + row[x - 1] + row[x + 1] - 4 * row[x];
+
+      next[x] = row[x] * (1 - LOSS) + CONDUCTION * flow + source[x];
+    }
+
+    for (U32 x = 0; x < WIDTH; ++x) {
+      hottest = std::max(hottest, next[x]);
+    }
+  }
+
+  return hottest;
+}
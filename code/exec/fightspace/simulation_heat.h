@@ -0,0 +1,31 @@
+#pragma once
+
+#include "exec/fightspace/simulation_kernels.h"
+#include "types.h"
+
+// temperature at a lower resolution than the cells. chunks hold a heat
+// field only while something in or next to them is warm, the rest are
+// skipped. a tick diffuses every field with a five point stencil, heats it
+// with the materials that burn and lets it cool off a little
+namespace simulation::heat {
+  // a heat cell covers SCALE x SCALE cells, 4 runs at quarter resolution
+  // and 2 at half
+  const U8  SCALE = 4;
+  const U8  WIDTH = simulation::kernels::ROW_WIDTH / SCALE;
+  const U16 CELLS = WIDTH * WIDTH;
+
+  // share of the difference to each neighbour that flows per tick. above
+  // 0.25 the stencil is unstable
+  const F32 CONDUCTION = 0.2f;
+
+  // share of its temperature a heat cell loses per tick
+  const F32 LOSS = 0.02f;
+
+  // fields whose hottest cell is below this are dropped
+  const F32 COLD = 1.0f / 256;
+
+  // window is the field with a border of one heat cell from the neighbours
+  // around it, WIDTH + 2 rows of WIDTH + 2. writes the next tick's field
+  // with sources added to out and returns its hottest cell
+  F32 diffuse(const F32* window, const F32* sources, F32* out);
+}
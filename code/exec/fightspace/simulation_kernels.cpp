@@ -0,0 +1,425 @@
+#include "simulation_kernels.h"
+
+#include "types.h"
+
+#include <cassert>
+#include <cstring>
+
+#if defined(__x86_64__) || defined(_M_X64)
+#define SIMULATION_X86 1
+#include <immintrin.h>
+#endif
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#define TARGET_AVX2
+#define TARGET_AVX512
+#else
+#define TARGET_AVX2   __attribute__((target("avx2")))
+#define TARGET_AVX512 __attribute__((target("avx512f,avx512bw")))
+#endif
+
+namespace {
+  const char SAND = static_cast<char>(MaterialType::SAND);
+  const char AIR  = static_cast<char>(MaterialType::AIR);
+
+#if defined(SIMULATION_X86) && defined(_MSC_VER)
+  bool _cpu_has(U32 leaf, U32 reg, U32 bit) {
+    int info[4];
+    __cpuidex(info, leaf, 0);
+    return (info[reg] >> bit) & 1;
+  }
+
+  bool _os_saves_ymm() {
+    return _cpu_has(1, 2, 27) && (_xgetbv(0) & 0x06) == 0x06;
+  }
+
+  bool _os_saves_zmm() {
+    return _cpu_has(1, 2, 27) && (_xgetbv(0) & 0xe6) == 0xe6;
+  }
+#endif
+}
+
+// sand falls one cell per tick into air. both sides of a move are decided
+// from the current tick alone: air pulls the cell above when it is sand, sand
+// leaves when the cell below is air
+U64 simulation::kernels::fall_row_scalar(const cells::Cell* above,
+                                         const cells::Cell* row,
+                                         const cells::Cell* below,
+                                         cells::Cell*       out,
+                                         U8                 min_x,
+                                         U8                 max_x) {
+  memcpy(out, row, ROW_WIDTH * sizeof(cells::Cell));
+
+  U64 changed = 0;
+
+  for (U32 x = min_x; x <= max_x; ++x) {
+    switch (cells::material(row[x])) {
+      case MaterialType::AIR: {
+        if (cells::material(above[x]) == MaterialType::SAND) {
+          out[x] = above[x];
+          changed |= U64(1) << x;
+        }
+        break;
+      }
+      case MaterialType::SAND: {
+        if (cells::material(below[x]) == MaterialType::AIR) {
+          out[x] = cells::make(MaterialType::AIR);
+          changed |= U64(1) << x;
+        }
+        break;
+      }
+      default:
+        break;
+    }
+  }
+
+  return changed;
+}
+
+#ifdef SIMULATION_X86
+
+#ifdef SIMULATION_PACKED_CELLS
+
+// 16 bit cells: compare the material bits, then move whole cells so
+// velocity travels with the material
+
+U64 simulation::kernels::fall_row_sse2(const cells::Cell* above,
+                                       const cells::Cell* row,
+                                       const cells::Cell* below,
+                                       cells::Cell*       out,
+                                       U8                 min_x,
+                                       U8                 max_x) {
+  const __m128i sand     = _mm_set1_epi16(SAND);
+  const __m128i air      = _mm_set1_epi16(AIR);
+  const __m128i material = _mm_set1_epi16(cells::MATERIAL_MASK);
+  const __m128i first    = _mm_set1_epi16(I16(min_x) - 1);
+  const __m128i last     = _mm_set1_epi16(I16(max_x) + 1);
+  const __m128i index    = _mm_setr_epi16(0, 1, 2, 3, 4, 5, 6, 7);
+
+  U64 changed = 0;
+
+  for (U32 offset = 0; offset < ROW_WIDTH; offset += 8) {
+    __m128i current =
+        _mm_loadu_si128(reinterpret_cast<const __m128i*>(row + offset));
+    auto out_ptr = reinterpret_cast<__m128i*>(out + offset);
+
+    if (offset > max_x || offset + 7 < min_x) {
+      _mm_storeu_si128(out_ptr, current);
+      continue;
+    }
+
+    __m128i up =
+        _mm_loadu_si128(reinterpret_cast<const __m128i*>(above + offset));
+    __m128i down =
+        _mm_loadu_si128(reinterpret_cast<const __m128i*>(below + offset));
+
+    __m128i column   = _mm_add_epi16(index, _mm_set1_epi16(offset));
+    __m128i in_range = _mm_and_si128(_mm_cmpgt_epi16(column, first),
+                                     _mm_cmpgt_epi16(last, column));
+
+    __m128i fall_in =
+        _mm_and_si128(_mm_cmpeq_epi16(_mm_and_si128(current, material), air),
+                      _mm_cmpeq_epi16(_mm_and_si128(up, material), sand));
+    __m128i fall_out =
+        _mm_and_si128(_mm_cmpeq_epi16(_mm_and_si128(current, material), sand),
+                      _mm_cmpeq_epi16(_mm_and_si128(down, material), air));
+
+    fall_in  = _mm_and_si128(fall_in, in_range);
+    fall_out = _mm_and_si128(fall_out, in_range);
+
+    __m128i next = _mm_or_si128(_mm_andnot_si128(fall_in, current),
+                                _mm_and_si128(fall_in, up));
+    next         = _mm_or_si128(_mm_andnot_si128(fall_out, next),
+                                _mm_and_si128(fall_out, air));
+
+    _mm_storeu_si128(out_ptr, next);
+
+    __m128i swap  = _mm_or_si128(fall_in, fall_out);
+    __m128i bytes = _mm_packs_epi16(swap, _mm_setzero_si128());
+    changed |= U64(U32(_mm_movemask_epi8(bytes))) << offset;
+  }
+
+  return changed;
+}
+
+TARGET_AVX2 U64 simulation::kernels::fall_row_avx2(const cells::Cell* above,
+                                                   const cells::Cell* row,
+                                                   const cells::Cell* below,
+                                                   cells::Cell*       out,
+                                                   U8                 min_x,
+                                                   U8                 max_x) {
+  const __m256i sand     = _mm256_set1_epi16(SAND);
+  const __m256i air      = _mm256_set1_epi16(AIR);
+  const __m256i material = _mm256_set1_epi16(cells::MATERIAL_MASK);
+  const __m256i first    = _mm256_set1_epi16(I16(min_x) - 1);
+  const __m256i last     = _mm256_set1_epi16(I16(max_x) + 1);
+  const __m256i index    = _mm256_setr_epi16(
+      0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15);
+
+  U64 changed = 0;
+
+  for (U32 offset = 0; offset < ROW_WIDTH; offset += 16) {
+    __m256i current =
+        _mm256_loadu_si256(reinterpret_cast<const __m256i*>(row + offset));
+    auto out_ptr = reinterpret_cast<__m256i*>(out + offset);
+
+    if (offset > max_x || offset + 15 < min_x) {
+      _mm256_storeu_si256(out_ptr, current);
+      continue;
+    }
+
+    __m256i up =
+        _mm256_loadu_si256(reinterpret_cast<const __m256i*>(above + offset));
+    __m256i down =
+        _mm256_loadu_si256(reinterpret_cast<const __m256i*>(below + offset));
+
+    __m256i column   = _mm256_add_epi16(index, _mm256_set1_epi16(offset));
+    __m256i in_range = _mm256_and_si256(_mm256_cmpgt_epi16(column, first),
+                                        _mm256_cmpgt_epi16(last, column));
+
+    __m256i current_material = _mm256_and_si256(current, material);
+
+    __m256i fall_in = _mm256_and_si256(
+        _mm256_cmpeq_epi16(current_material, air),
+        _mm256_cmpeq_epi16(_mm256_and_si256(up, material), sand));
+    __m256i fall_out = _mm256_and_si256(
+        _mm256_cmpeq_epi16(current_material, sand),
+        _mm256_cmpeq_epi16(_mm256_and_si256(down, material), air));
+
+    fall_in  = _mm256_and_si256(fall_in, in_range);
+    fall_out = _mm256_and_si256(fall_out, in_range);
+
+    __m256i next = _mm256_blendv_epi8(current, up, fall_in);
+    next         = _mm256_blendv_epi8(next, air, fall_out);
+
+    _mm256_storeu_si256(out_ptr, next);
+
+    // packs works per 128 bit lane, so the lane masks land in bytes 0-7
+    // and 16-23
+    __m256i swap  = _mm256_or_si256(fall_in, fall_out);
+    U32     bytes = _mm256_movemask_epi8(
+        _mm256_packs_epi16(swap, _mm256_setzero_si256()));
+    U64 bits = (bytes & 0xff) | ((bytes >> 8) & 0xff00);
+    changed |= bits << offset;
+  }
+
+  return changed;
+}
+
+TARGET_AVX512 U64
+simulation::kernels::fall_row_avx512(const cells::Cell* above,
+                                     const cells::Cell* row,
+                                     const cells::Cell* below,
+                                     cells::Cell*       out,
+                                     U8                 min_x,
+                                     U8                 max_x) {
+  const __m512i sand     = _mm512_set1_epi16(SAND);
+  const __m512i air      = _mm512_set1_epi16(AIR);
+  const __m512i material = _mm512_set1_epi16(cells::MATERIAL_MASK);
+
+  U64 lanes = (~U64(0) >> (ROW_WIDTH - 1 - max_x)) & (~U64(0) << min_x);
+
+  U64 changed = 0;
+
+  for (U32 offset = 0; offset < ROW_WIDTH; offset += 32) {
+    __m512i current = _mm512_loadu_si512(row + offset);
+    __m512i up      = _mm512_loadu_si512(above + offset);
+    __m512i down    = _mm512_loadu_si512(below + offset);
+
+    __mmask32 range = __mmask32(lanes >> offset);
+
+    __mmask32 fall_in =
+        _mm512_cmpeq_epi16_mask(_mm512_and_si512(current, material), air) &
+        _mm512_cmpeq_epi16_mask(_mm512_and_si512(up, material), sand) & range;
+    __mmask32 fall_out =
+        _mm512_cmpeq_epi16_mask(_mm512_and_si512(current, material), sand) &
+        _mm512_cmpeq_epi16_mask(_mm512_and_si512(down, material), air) &
+        range;
+
+    __m512i next = _mm512_mask_blend_epi16(fall_in, current, up);
+    next         = _mm512_mask_blend_epi16(fall_out, next, air);
+
+    _mm512_storeu_si512(out + offset, next);
+
+    changed |= U64(fall_in | fall_out) << offset;
+  }
+
+  return changed;
+}
+
+#else
+
+U64 simulation::kernels::fall_row_sse2(const cells::Cell* above,
+                                       const cells::Cell* row,
+                                       const cells::Cell* below,
+                                       cells::Cell*       out,
+                                       U8                 min_x,
+                                       U8                 max_x) {
+  const __m128i sand  = _mm_set1_epi8(SAND);
+  const __m128i air   = _mm_set1_epi8(AIR);
+  const __m128i first = _mm_set1_epi8(min_x - 1);
+  const __m128i last  = _mm_set1_epi8(max_x + 1);
+  const __m128i index =
+      _mm_setr_epi8(0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15);
+
+  U64 changed = 0;
+
+  for (U32 offset = 0; offset < ROW_WIDTH; offset += 16) {
+    __m128i current =
+        _mm_loadu_si128(reinterpret_cast<const __m128i*>(row + offset));
+    auto out_ptr = reinterpret_cast<__m128i*>(out + offset);
+
+    if (offset > max_x || offset + 15 < min_x) {
+      _mm_storeu_si128(out_ptr, current);
+      continue;
+    }
+
+    __m128i up =
+        _mm_loadu_si128(reinterpret_cast<const __m128i*>(above + offset));
+    __m128i down =
+        _mm_loadu_si128(reinterpret_cast<const __m128i*>(below + offset));
+
+    __m128i column   = _mm_add_epi8(index, _mm_set1_epi8(offset));
+    __m128i in_range = _mm_and_si128(_mm_cmpgt_epi8(column, first),
+                                     _mm_cmpgt_epi8(last, column));
+
+    __m128i fall_in = _mm_and_si128(_mm_cmpeq_epi8(current, air),
+                                    _mm_cmpeq_epi8(up, sand));
+    __m128i fall_out = _mm_and_si128(_mm_cmpeq_epi8(current, sand),
+                                     _mm_cmpeq_epi8(down, air));
+
+    // air and sand swap places, so the swap is a xor with sand ^ air
+    __m128i swap = _mm_and_si128(_mm_or_si128(fall_in, fall_out), in_range);
+
+    __m128i flip = _mm_and_si128(swap, _mm_xor_si128(sand, air));
+    _mm_storeu_si128(out_ptr, _mm_xor_si128(current, flip));
+
+    changed |= U64(U32(_mm_movemask_epi8(swap))) << offset;
+  }
+
+  return changed;
+}
+
+TARGET_AVX2 U64 simulation::kernels::fall_row_avx2(const cells::Cell* above,
+                                                   const cells::Cell* row,
+                                                   const cells::Cell* below,
+                                                   cells::Cell*       out,
+                                                   U8                 min_x,
+                                                   U8                 max_x) {
+  const __m256i sand  = _mm256_set1_epi8(SAND);
+  const __m256i air   = _mm256_set1_epi8(AIR);
+  const __m256i first = _mm256_set1_epi8(min_x - 1);
+  const __m256i last  = _mm256_set1_epi8(max_x + 1);
+  const __m256i index = _mm256_setr_epi8(0,  1,  2,  3,  4,  5,  6,  7,
+                                         8,  9,  10, 11, 12, 13, 14, 15,
+                                         16, 17, 18, 19, 20, 21, 22, 23,
+                                         24, 25, 26, 27, 28, 29, 30, 31);
+
+  U64 changed = 0;
+
+  for (U32 offset = 0; offset < ROW_WIDTH; offset += 32) {
+    __m256i current =
+        _mm256_loadu_si256(reinterpret_cast<const __m256i*>(row + offset));
+    auto out_ptr = reinterpret_cast<__m256i*>(out + offset);
+
+    if (offset > max_x || offset + 31 < min_x) {
+      _mm256_storeu_si256(out_ptr, current);
+      continue;
+    }
+
+    __m256i up =
+        _mm256_loadu_si256(reinterpret_cast<const __m256i*>(above + offset));
+    __m256i down =
+        _mm256_loadu_si256(reinterpret_cast<const __m256i*>(below + offset));
+
+    __m256i column   = _mm256_add_epi8(index, _mm256_set1_epi8(offset));
+    __m256i in_range = _mm256_and_si256(_mm256_cmpgt_epi8(column, first),
+                                        _mm256_cmpgt_epi8(last, column));
+
+    __m256i fall_in  = _mm256_and_si256(_mm256_cmpeq_epi8(current, air),
+                                       _mm256_cmpeq_epi8(up, sand));
+    __m256i fall_out = _mm256_and_si256(_mm256_cmpeq_epi8(current, sand),
+                                        _mm256_cmpeq_epi8(down, air));
+
+    fall_in  = _mm256_and_si256(fall_in, in_range);
+    fall_out = _mm256_and_si256(fall_out, in_range);
+
+    __m256i next = _mm256_blendv_epi8(current, sand, fall_in);
+    next         = _mm256_blendv_epi8(next, air, fall_out);
+
+    _mm256_storeu_si256(out_ptr, next);
+
+    __m256i swap = _mm256_or_si256(fall_in, fall_out);
+    changed |= U64(U32(_mm256_movemask_epi8(swap))) << offset;
+  }
+
+  return changed;
+}
+
+TARGET_AVX512 U64
+simulation::kernels::fall_row_avx512(const cells::Cell* above,
+                                     const cells::Cell* row,
+                                     const cells::Cell* below,
+                                     cells::Cell*       out,
+                                     U8                 min_x,
+                                     U8                 max_x) {
+  const __m512i sand = _mm512_set1_epi8(SAND);
+  const __m512i air  = _mm512_set1_epi8(AIR);
+
+  U64 lanes = (~U64(0) >> (ROW_WIDTH - 1 - max_x)) & (~U64(0) << min_x);
+
+  __m512i current = _mm512_loadu_si512(row);
+  __m512i up      = _mm512_loadu_si512(above);
+  __m512i down    = _mm512_loadu_si512(below);
+
+  __mmask64 fall_in = _mm512_cmpeq_epi8_mask(current, air) &
+                      _mm512_cmpeq_epi8_mask(up, sand) & lanes;
+  __mmask64 fall_out = _mm512_cmpeq_epi8_mask(current, sand) &
+                       _mm512_cmpeq_epi8_mask(down, air) & lanes;
+
+  __m512i next = _mm512_mask_blend_epi8(fall_in, current, sand);
+  next         = _mm512_mask_blend_epi8(fall_out, next, air);
+
+  _mm512_storeu_si512(out, next);
+
+  return fall_in | fall_out;
+}
+
+#endif
+
+simulation::Kernel simulation::kernels::best() {
+#if defined(_MSC_VER)
+  if (_cpu_has(7, 1, 30) && _os_saves_zmm()) return Kernel::AVX512;
+  if (_cpu_has(7, 1, 5) && _os_saves_ymm()) return Kernel::AVX2;
+#else
+  __builtin_cpu_init();
+
+  if (__builtin_cpu_supports("avx512bw")) return Kernel::AVX512;
+  if (__builtin_cpu_supports("avx2")) return Kernel::AVX2;
+#endif
+  return Kernel::SSE2;
+}
+
+#else
+
+simulation::Kernel simulation::kernels::best() { return Kernel::SCALAR; }
+
+#endif
+
+simulation::kernels::FallRowFn simulation::kernels::fall_row(Kernel kernel) {
+  assert(kernel <= best() && "Kernel not supported by this cpu");
+
+  switch (kernel) {
+#ifdef SIMULATION_X86
+    case Kernel::SSE2:
+      return fall_row_sse2;
+    case Kernel::AVX2:
+      return fall_row_avx2;
+    case Kernel::AVX512:
+      return fall_row_avx512;
+#endif
+    default:
+      return fall_row_scalar;
+  }
+}
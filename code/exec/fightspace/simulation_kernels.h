@@ -0,0 +1,49 @@
+#pragma once
+
+#include "exec/fightspace/simulation.h"
+#include "exec/fightspace/simulation_cells.h"
+#include "types.h"
+
+// row kernels compute one 64 cell chunk row of the next tick from the row and
+// its neighbours above and below in the current tick. only columns
+// min_x..max_x can change, the rest of out is a copy of row. they return a
+// mask with bit x set for every column that changed
+namespace simulation::kernels {
+  const U8 ROW_WIDTH = 64;
+
+  typedef U64 (*FallRowFn)(const cells::Cell* above,
+                           const cells::Cell* row,
+                           const cells::Cell* below,
+                           cells::Cell*       out,
+                           U8                 min_x,
+                           U8                 max_x);
+
+  U64 fall_row_scalar(const cells::Cell* above,
+                      const cells::Cell* row,
+                      const cells::Cell* below,
+                      cells::Cell*       out,
+                      U8                 min_x,
+                      U8                 max_x);
+  U64 fall_row_sse2(const cells::Cell* above,
+                    const cells::Cell* row,
+                    const cells::Cell* below,
+                    cells::Cell*       out,
+                    U8                 min_x,
+                    U8                 max_x);
+  U64 fall_row_avx2(const cells::Cell* above,
+                    const cells::Cell* row,
+                    const cells::Cell* below,
+                    cells::Cell*       out,
+                    U8                 min_x,
+                    U8                 max_x);
+  U64 fall_row_avx512(const cells::Cell* above,
+                      const cells::Cell* row,
+                      const cells::Cell* below,
+                      cells::Cell*       out,
+                      U8                 min_x,
+                      U8                 max_x);
+
+  // widest kernel the cpu supports, from cpuid
+  Kernel    best();
+  FallRowFn fall_row(Kernel kernel);
+}
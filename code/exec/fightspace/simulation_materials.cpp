@@ -0,0 +1,191 @@
+#include "simulation_materials.h"
+
+#include "types.h"
+
+#include <array>
+#include <cstring>
+#include <utility>
+
+using simulation::cells::Cell;
+using simulation::materials::Rule;
+
+namespace {
+  struct Window {
+    const Cell* const*         rows; // y - 1 to y + 2
+    const F32*                 heat; // heat cells of row y, nullptr when cold
+    I8                         dir;
+    simulation::random::Stream stream;
+    U32                        counter; // of cell 0's first draw
+  };
+
+  // what a cell draws its random numbers for
+  enum Draw : U8 {
+    IGNITE,
+    REACT,
+  };
+
+  static_assert(REACT < simulation::materials::DRAWS,
+                "Every draw needs a counter of its own");
+
+  const Rule& _rule(Cell cell) {
+    return simulation::materials::RULES[U8(simulation::cells::material(cell))];
+  }
+
+  bool _would_fall(Cell cell, Cell below) {
+    auto& cell_rule  = _rule(cell);
+    auto& below_rule = _rule(below);
+
+    return cell_rule.gravity && !below_rule.fixed &&
+           below_rule.density < cell_rule.density;
+  }
+
+  // the cell in row, 0 or 1, swaps with the one below it. it doesn't when
+  // the one below is about to fall itself
+  bool _falls(const Window& window, U8 row, I32 x) {
+    return _would_fall(window.rows[row][x], window.rows[row + 1][x]) &&
+           !_would_fall(window.rows[row + 1][x], window.rows[row + 2][x]);
+  }
+
+  // the cell at x swaps with its neighbour at x + dir. the neighbour must be
+  // lighter and unable to move on its own, and neither cell may be the
+  // target of something falling
+  bool _flows(const Window& window, I32 x, I8 dir) {
+    auto  source      = window.rows[1][x];
+    auto  target      = window.rows[1][x + dir];
+    auto& source_rule = _rule(source);
+    auto& target_rule = _rule(target);
+
+    return source_rule.spread && !target_rule.fixed && !target_rule.gravity &&
+           !target_rule.spread && target_rule.density < source_rule.density &&
+           !_falls(window, 1, x) && !_falls(window, 0, x) &&
+           !_falls(window, 0, x + dir);
+  }
+
+  U8 _chance(const Window& window, I32 x, Draw draw) {
+    return simulation::random::chance(
+        window.stream,
+        window.counter + x * simulation::materials::DRAWS + draw);
+  }
+
+  template <MaterialType M>
+  Cell _react(const Window& window, I32 x, bool& busy) {
+    constexpr auto& reactions = simulation::materials::REACTIONS.table[U8(M)];
+    constexpr auto& rule      = simulation::materials::RULES[U8(M)];
+
+    auto self = window.rows[1][x];
+
+    if constexpr (rule.flammability > 0) {
+      if (window.heat &&
+          window.heat[x / simulation::heat::SCALE] >= rule.ignition) {
+        busy = true;
+
+        if (_chance(window, x, IGNITE) < rule.flammability) {
+          return simulation::cells::make(MaterialType::FIRE);
+        }
+      }
+    }
+
+    if constexpr (simulation::materials::_reacts_with(M) == 0 &&
+                  rule.decay == 0) {
+      return self;
+    }
+
+    const Cell neighbours[4] = {
+        window.rows[0][x],
+        window.rows[2][x],
+        window.rows[1][x - 1],
+        window.rows[1][x + 1],
+    };
+
+    simulation::materials::Reaction reaction = {.chance = rule.decay};
+
+    for (auto neighbour : neighbours) {
+      auto& candidate =
+          reactions[U8(simulation::cells::material(neighbour))];
+
+      if (candidate.chance > reaction.chance) reaction = candidate;
+    }
+
+    if (!reaction.chance) return self;
+
+    busy = true;
+
+    if (_chance(window, x, REACT) >= reaction.chance) return self;
+
+    return simulation::cells::make(reaction.into);
+  }
+
+  template <MaterialType M>
+  Cell _step(const Window& window, I32 x, bool& busy) {
+    constexpr auto& rule = simulation::materials::RULES[U8(M)];
+
+    if constexpr (rule.fixed) return _react<M>(window, x, busy);
+
+    if constexpr (rule.gravity) {
+      if (_falls(window, 1, x)) return window.rows[2][x];
+    }
+
+    if (_falls(window, 0, x)) return window.rows[0][x];
+
+    if constexpr (rule.spread) {
+      if (_flows(window, x, window.dir)) return window.rows[1][x + window.dir];
+
+      // could flow the other way on the next tick
+      if (_flows(window, x, -window.dir)) busy = true;
+    } else if constexpr (!rule.gravity) {
+      if (_flows(window, x - window.dir, window.dir)) {
+        return window.rows[1][x - window.dir];
+      }
+    }
+
+    return window.rows[1][x];
+  }
+
+  typedef Cell (*StepFn)(const Window& window, I32 x, bool& busy);
+
+  template <U8... MATERIALS>
+  constexpr auto _steps(std::integer_sequence<U8, MATERIALS...>) {
+    return std::array<StepFn, sizeof...(MATERIALS)>{
+        _step<MaterialType(MATERIALS)>...};
+  }
+
+  constexpr auto STEPS = _steps(
+      std::make_integer_sequence<U8, simulation::materials::MATERIAL_COUNT>());
+}
+
+U64 simulation::materials::update_row(const Cell* const rows[4],
+                                      const F32*        heat,
+                                      Cell*             out,
+                                      U8                min_x,
+                                      U8                max_x,
+                                      I8                dir,
+                                      random::Stream    stream,
+                                      U32               counter,
+                                      U64&              busy,
+                                      U16&              materials) {
+  Window window = {
+      .rows    = rows,
+      .heat    = heat,
+      .dir     = dir,
+      .stream  = stream,
+      .counter = counter,
+  };
+
+  memcpy(out, rows[1], 64 * sizeof(Cell));
+
+  U64 changed = 0;
+
+  for (I32 x = min_x; x <= max_x; ++x) {
+    bool cell_busy = false;
+    auto material  = U8(cells::material(rows[1][x]));
+
+    out[x] = STEPS[material](window, x, cell_busy);
+
+    materials |= 1 << U8(cells::material(out[x]));
+
+    if (out[x] != rows[1][x]) changed |= U64(1) << x;
+    if (cell_busy) busy |= U64(1) << x;
+  }
+
+  return changed;
+}
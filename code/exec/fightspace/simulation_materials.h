@@ -0,0 +1,216 @@
+#pragma once
+
+#include "exec/fightspace/simulation.h"
+#include "exec/fightspace/simulation_cells.h"
+#include "exec/fightspace/simulation_heat.h"
+#include "exec/fightspace/simulation_random.h"
+#include "types.h"
+
+// how each material behaves, as data. simulation_materials.cpp turns every
+// row of RULES into an update function of its own at compile time, so the
+// inner loop does one table call per cell instead of a switch
+//
+// all rules pull: a cell's next value only depends on the cells around it in
+// the current tick, rows y - 1 to y + 2 and columns x - 1 to x + 1. moves are
+// swaps that both sides agree on, so chunks can update in any order
+namespace simulation::materials {
+  const U8 MATERIAL_COUNT = U8(MaterialType::FIRE) + 1;
+
+  struct Rule {
+    // heavier materials with gravity sink through lighter ones
+    U8   density = 0;
+    bool gravity = false;
+
+    // never moves and nothing moves into it. only reactions change it
+    bool fixed = false;
+
+    // flows sideways into lighter, unmoving cells when it can't fall
+    bool spread = false;
+
+    // holds together with the solid cells it touches. regions of them that
+    // lose hold of the level become bodies
+    bool solid = false;
+
+    // chance out of 256 per tick to catch fire once its heat cell is at
+    // ignition or hotter
+    U16 flammability = 0;
+    F32 ignition     = 0.0f;
+
+    // temperature a heat cell full of this material gains per tick
+    F32 heat = 0.0f;
+
+    // chance out of 256 per tick to burn out into AIR
+    U16 decay = 0;
+  };
+
+  constexpr Rule RULES[MATERIAL_COUNT] = {
+      /* BORDER */ {.density = 255, .fixed = true},
+      /* AIR    */ {.density = 0},
+      /* SAND   */ {.density = 3, .gravity = true},
+      /* WATER  */ {.density = 2, .gravity = true, .spread = true},
+      /* WOOD   */
+      {.density      = 4,
+       .fixed        = true,
+       .solid        = true,
+       .flammability = 64,
+       .ignition     = 0.25f},
+      /* STONE  */ {.density = 5, .fixed = true, .solid = true},
+      /* FIRE   */ {.density = 1, .fixed = true, .heat = 4.0f, .decay = 4},
+  };
+
+  constexpr const Rule& rule(MaterialType material) {
+    return RULES[U8(material)];
+  }
+
+  constexpr U16 bit(MaterialType material) { return 1 << U8(material); }
+
+  constexpr U16 _materials_where(bool (*test)(const Rule& rule)) {
+    U16 materials = 0;
+
+    for (U8 material = 0; material < MATERIAL_COUNT; ++material) {
+      if (test(RULES[material])) materials |= 1 << material;
+    }
+
+    return materials;
+  }
+
+  // materials that heat the field around them, and ones it sets on fire
+  constexpr U16 HEATING = _materials_where(
+      [](const Rule& rule) { return rule.heat > 0.0f; });
+  constexpr U16 FLAMMABLE = _materials_where(
+      [](const Rule& rule) { return rule.flammability > 0; });
+
+  // materials that hold together into bodies
+  constexpr U16 SOLID =
+      _materials_where([](const Rule& rule) { return rule.solid; });
+
+  // the lowest temperature anything in materials catches fire at, 0 when
+  // nothing does
+  constexpr F32 ignition(U16 materials) {
+    F32 lowest = 0.0f;
+
+    for (U8 material = 0; material < MATERIAL_COUNT; ++material) {
+      if (!(materials & FLAMMABLE & (1 << material))) continue;
+
+      if (lowest == 0.0f || RULES[material].ignition < lowest) {
+        lowest = RULES[material].ignition;
+      }
+    }
+
+    return lowest;
+  }
+
+  // what a fixed cell turns into when it touches another material, with a
+  // chance out of 256 per tick. catching fire goes through the heat field
+  // instead
+  struct Reaction {
+    MaterialType into   = MaterialType::AIR;
+    U16          chance = 0;
+  };
+
+  constexpr Reaction _reaction(MaterialType self, MaterialType other) {
+    if (self == MaterialType::FIRE && other == MaterialType::WATER) {
+      return {MaterialType::AIR, 256};
+    }
+
+    return {};
+  }
+
+  struct Reactions {
+    Reaction table[MATERIAL_COUNT][MATERIAL_COUNT];
+  };
+
+  constexpr Reactions _reactions() {
+    Reactions reactions;
+
+    for (U8 self = 0; self < MATERIAL_COUNT; ++self) {
+      for (U8 other = 0; other < MATERIAL_COUNT; ++other) {
+        reactions.table[self][other] =
+            _reaction(MaterialType(self), MaterialType(other));
+      }
+    }
+
+    return reactions;
+  }
+
+  constexpr Reactions REACTIONS = _reactions();
+
+  constexpr U16 _reacts_with(MaterialType self) {
+    U16 materials = 0;
+
+    for (U8 other = 0; other < MATERIAL_COUNT; ++other) {
+      if (REACTIONS.table[U8(self)][other].chance) materials |= 1 << other;
+    }
+
+    return materials;
+  }
+
+  // true when the row kernels, which only let SAND fall into AIR, give the
+  // same result as the rules for every cell made of these materials in a
+  // chunk without a heat field
+  constexpr bool _fall_kernel_set(U16 materials) {
+    for (U8 material = 0; material < MATERIAL_COUNT; ++material) {
+      if (!(materials & (1 << material))) continue;
+
+      auto type = MaterialType(material);
+
+      if (type == MaterialType::AIR || type == MaterialType::SAND) continue;
+
+      if (!rule(type).fixed || rule(type).decay) return false;
+      if (_reacts_with(type) & materials) return false;
+    }
+
+    return true;
+  }
+
+  struct FallKernelSets {
+    bool sets[1 << MATERIAL_COUNT];
+  };
+
+  constexpr FallKernelSets _fall_kernel_sets() {
+    FallKernelSets sets;
+
+    for (U16 materials = 0; materials < (1 << MATERIAL_COUNT); ++materials) {
+      sets.sets[materials] = _fall_kernel_set(materials);
+    }
+
+    return sets;
+  }
+
+  constexpr FallKernelSets FALL_KERNEL_SETS = _fall_kernel_sets();
+
+  static_assert(rule(MaterialType::SAND).gravity &&
+                    !rule(MaterialType::SAND).spread &&
+                    rule(MaterialType::SAND).density >
+                        rule(MaterialType::AIR).density,
+                "The row kernels assume SAND falls through AIR");
+  static_assert(!rule(MaterialType::AIR).gravity &&
+                    !rule(MaterialType::AIR).fixed,
+                "The row kernels assume AIR can be fallen into");
+
+  inline bool fall_kernel_handles(U16 materials) {
+    return FALL_KERNEL_SETS.sets[materials];
+  }
+
+  // random numbers a cell draws per tick at most, one to catch fire and
+  // one to react
+  const U8 DRAWS = 2;
+
+  // rows points at column 0 of rows y - 1 to y + 2, each readable from column
+  // -1 to 64. heat is the row of the heat field covering row y, nullptr in
+  // a cold chunk. dir is the side liquids flow to this tick, 1 or -1. cell x
+  // draws the chances of its reactions from stream at counter + x * DRAWS
+  // on. returns the changed columns like the row kernels, sets a bit in busy
+  // for cells that did not change but might next tick, and ors the
+  // materials written into materials
+  U64 update_row(const cells::Cell* const rows[4],
+                 const F32*               heat,
+                 cells::Cell*             out,
+                 U8                       min_x,
+                 U8                       max_x,
+                 I8                       dir,
+                 random::Stream           stream,
+                 U32                      counter,
+                 U64&                     busy,
+                 U16&                     materials);
+}
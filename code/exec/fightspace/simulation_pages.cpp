@@ -0,0 +1,197 @@
+#include "simulation_pages.h"
+
+#include "types.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cassert>
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <fstream>
+#include <mutex>
+#include <thread>
+
+namespace {
+  const U32 MAX_REQUESTS = 256;
+
+  typedef std::chrono::steady_clock Clock;
+
+  struct Request {
+    bool              write;
+    U32               record;
+    U8*               data;
+    Clock::time_point queued;
+  };
+
+  std::fstream _file;
+  std::mutex   _file_mutex;
+  U32          _record_size = 0;
+
+  std::thread             _thread;
+  std::mutex              _mutex;
+  std::condition_variable _wake;
+  std::condition_variable _progress;
+  bool                    _quit = false;
+
+  // ring of queued requests, ticket t lives at t % MAX_REQUESTS
+  Request          _requests[MAX_REQUESTS];
+  U64              _queued = 0;
+  std::atomic<U64> _completed{0};
+
+  simulation::pages::Counters _counters;
+
+  void _seek(U32 record) {
+    auto offset = std::streamoff(record) * _record_size;
+
+    _file.seekg(offset);
+    _file.seekp(offset);
+  }
+
+  void _count_read(Clock::time_point queued) {
+    auto elapsed = Clock::now() - queued;
+    U64  ns =
+        std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count();
+
+    ++_counters.reads;
+    _counters.read_ns += ns;
+    _counters.max_read_ns = std::max(_counters.max_read_ns, ns);
+  }
+
+  void _io_loop() {
+    for (;;) {
+      Request request;
+
+      {
+        std::unique_lock lock(_mutex);
+        _wake.wait(lock, [] { return _quit || _completed < _queued; });
+
+        if (_completed == _queued) return;
+
+        request = _requests[_completed % MAX_REQUESTS];
+      }
+
+      {
+        std::lock_guard lock(_file_mutex);
+        _seek(request.record);
+
+        if (request.write) {
+          _file.write(reinterpret_cast<const char*>(request.data),
+                      _record_size);
+        } else {
+          _file.read(reinterpret_cast<char*>(request.data), _record_size);
+        }
+
+        assert(_file.good() && "Chunk page i/o failed");
+      }
+
+      {
+        std::lock_guard lock(_mutex);
+
+        if (request.write) {
+          ++_counters.writes;
+        } else {
+          _count_read(request.queued);
+        }
+
+        _completed.fetch_add(1, std::memory_order_release);
+      }
+      _progress.notify_all();
+    }
+  }
+
+  U64 _queue(bool write, U32 record, U8* data) {
+    assert(_file.is_open() && "Page file is not open");
+
+    std::unique_lock lock(_mutex);
+    _progress.wait(lock, [] { return _queued - _completed < MAX_REQUESTS; });
+
+    _requests[_queued % MAX_REQUESTS] = Request{
+        .write  = write,
+        .record = record,
+        .data   = data,
+        .queued = Clock::now(),
+    };
+
+    U64 ticket = ++_queued;
+
+    lock.unlock();
+    _wake.notify_one();
+
+    return ticket;
+  }
+}
+
+bool simulation::pages::open(const char* path, U32 record_size) {
+  close();
+
+  _file.open(path,
+             std::ios::in | std::ios::out | std::ios::trunc | std::ios::binary);
+
+  if (!_file.is_open()) {
+    printf("failed to open page file: '%s'\n", path);
+    return false;
+  }
+
+  _record_size = record_size;
+  _quit        = false;
+  _queued      = 0;
+  _completed   = 0;
+  _counters    = Counters{};
+
+  _thread = std::thread(_io_loop);
+
+  return true;
+}
+
+void simulation::pages::close() {
+  if (!_file.is_open()) return;
+
+  {
+    std::lock_guard lock(_mutex);
+    _quit = true;
+  }
+  _wake.notify_one();
+  _thread.join();
+
+  _file.close();
+}
+
+bool simulation::pages::is_open() { return _file.is_open(); }
+
+U64 simulation::pages::read(U32 record, U8* data) {
+  return _queue(false, record, data);
+}
+
+U64 simulation::pages::write(U32 record, const U8* data) {
+  return _queue(true, record, const_cast<U8*>(data));
+}
+
+void simulation::pages::read_now(U32 record, U8* data) {
+  auto started = Clock::now();
+
+  {
+    std::lock_guard lock(_file_mutex);
+    _seek(record);
+    _file.read(reinterpret_cast<char*>(data), _record_size);
+
+    assert(_file.good() && "Chunk page i/o failed");
+  }
+
+  std::lock_guard lock(_mutex);
+  _count_read(started);
+}
+
+bool simulation::pages::done(U64 ticket) {
+  return _completed.load(std::memory_order_acquire) >= ticket;
+}
+
+void simulation::pages::wait(U64 ticket) {
+  std::unique_lock lock(_mutex);
+  _progress.wait(lock, [&] { return _completed >= ticket; });
+}
+
+simulation::pages::Counters simulation::pages::counters() {
+  std::lock_guard lock(_mutex);
+  return _counters;
+}
@@ -0,0 +1,32 @@
+#pragma once
+
+#include "types.h"
+
+// a file of fixed size chunk records. reads and writes are queued to one
+// background thread and complete in the order they were queued. a ticket
+// identifies a request, a request is done once the completed ticket count
+// has passed it
+namespace simulation::pages {
+  struct Counters {
+    U32 reads       = 0;
+    U32 writes      = 0;
+    U64 read_ns     = 0; // summed time from queueing a read to its completion
+    U64 max_read_ns = 0;
+  };
+
+  bool open(const char* path, U32 record_size);
+  void close();
+  bool is_open();
+
+  // data has to stay untouched until the request is done
+  U64 read(U32 record, U8* data);
+  U64 write(U32 record, const U8* data);
+
+  // reads on the calling thread, bypassing the queue
+  void read_now(U32 record, U8* data);
+
+  bool done(U64 ticket);
+  void wait(U64 ticket);
+
+  Counters counters();
+}
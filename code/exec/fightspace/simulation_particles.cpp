@@ -0,0 +1,73 @@
+#include "simulation_particles.h"
+
+#include "arena.h"
+#include "fnv-1a/fnv.h"
+#include "types.h"
+
+#include <cassert>
+#include <cstring>
+
+simulation::particles::Pool simulation::particles::init(ArenaHandle arena,
+                                                        U32 capacity) {
+  return Pool{
+      .capacity   = capacity,
+      .x          = arena::alloc<F32>(arena, capacity * sizeof(F32)),
+      .y          = arena::alloc<F32>(arena, capacity * sizeof(F32)),
+      .velocity_x = arena::alloc<F32>(arena, capacity * sizeof(F32)),
+      .velocity_y = arena::alloc<F32>(arena, capacity * sizeof(F32)),
+      .material   = arena::alloc<MaterialType>(arena, capacity),
+  };
+}
+
+bool simulation::particles::spawn(Pool&        pool,
+                                  F32          x,
+                                  F32          y,
+                                  F32          velocity_x,
+                                  F32          velocity_y,
+                                  MaterialType material) {
+  if (pool.count == pool.capacity) return false;
+
+  U32 index = pool.count++;
+
+  pool.x[index]          = x;
+  pool.y[index]          = y;
+  pool.velocity_x[index] = velocity_x;
+  pool.velocity_y[index] = velocity_y;
+  pool.material[index]   = material;
+
+  return true;
+}
+
+void simulation::particles::move(Pool& pool, U32 from, U32 into) {
+  pool.x[into]          = pool.x[from];
+  pool.y[into]          = pool.y[from];
+  pool.velocity_x[into] = pool.velocity_x[from];
+  pool.velocity_y[into] = pool.velocity_y[from];
+  pool.material[into]   = pool.material[from];
+}
+
+void simulation::particles::copy(const Pool& from, Pool& into) {
+  assert(into.capacity >= from.count && "Particle pool too small");
+
+  into.count = from.count;
+
+  memcpy(into.x, from.x, from.count * sizeof(F32));
+  memcpy(into.y, from.y, from.count * sizeof(F32));
+  memcpy(into.velocity_x, from.velocity_x, from.count * sizeof(F32));
+  memcpy(into.velocity_y, from.velocity_y, from.count * sizeof(F32));
+  memcpy(into.material, from.material, from.count);
+}
+
+U64 simulation::particles::hash(const Pool& pool) {
+  if (pool.count == 0) return 0;
+
+  U32 count = pool.count;
+
+  U64 hash = fnv_64a_buf(&count, sizeof(count), FNV1A_64_INIT);
+  hash     = fnv_64a_buf(pool.x, pool.count * sizeof(F32), hash);
+  hash     = fnv_64a_buf(pool.y, pool.count * sizeof(F32), hash);
+  hash     = fnv_64a_buf(pool.velocity_x, pool.count * sizeof(F32), hash);
+  hash     = fnv_64a_buf(pool.velocity_y, pool.count * sizeof(F32), hash);
+
+  return fnv_64a_buf(pool.material, pool.count, hash);
+}
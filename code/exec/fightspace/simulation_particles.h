@@ -0,0 +1,44 @@
+#pragma once
+
+#include "exec/fightspace/simulation.h"
+#include "handles.h"
+#include "types.h"
+
+// material in free flight. cells pushed hard enough leave the chunk grid and
+// fly here until they hit something, then land back into a cell. the pool is
+// a structure of arrays so a tick integrates it in bulk, positions and
+// velocities are in cells and cells per tick
+namespace simulation::particles {
+  // cells per tick added to velocity_y every tick
+  const F32 GRAVITY = 0.125f;
+
+  struct Pool {
+    U32 count    = 0;
+    U32 capacity = 0;
+
+    F32*          x          = nullptr;
+    F32*          y          = nullptr;
+    F32*          velocity_x = nullptr;
+    F32*          velocity_y = nullptr;
+    MaterialType* material   = nullptr;
+  };
+
+  Pool init(ArenaHandle arena, U32 capacity);
+
+  // false when the pool is full
+  bool spawn(Pool&        pool,
+             F32          x,
+             F32          y,
+             F32          velocity_x,
+             F32          velocity_y,
+             MaterialType material);
+
+  // overwrites particle into with particle from, for compacting the pool
+  void move(Pool& pool, U32 from, U32 into);
+
+  // into needs at least from.count capacity
+  void copy(const Pool& from, Pool& into);
+
+  // 0 for an empty pool
+  U64 hash(const Pool& pool);
+}
@@ -0,0 +1,43 @@
+#pragma once
+
+#include "types.h"
+
+// counter based random numbers. a stream is only a key, and its n-th number
+// is a hash of the key and n. numbers can be drawn in any order and on any
+// thread and come out the same, so a chunk update keys a stream of its own
+// by chunk and tick and never shares state with another one. drawing is a
+// few multiplies and shifts without branches, loops over counters turn into
+// vector code
+namespace simulation::random {
+  struct Stream {
+    U32 key;
+  };
+
+  // a bijection of U32 that flips about half the bits of the result for
+  // every bit flipped in value, the lowbias32 hash
+  constexpr U32 mix(U32 value) {
+    value ^= value >> 16;
+    value *= 0x7feb352du;
+    value ^= value >> 15;
+    value *= 0x846ca68bu;
+    value ^= value >> 16;
+
+    return value;
+  }
+
+  constexpr Stream stream(U32 tick, U32 x, U32 y) {
+    return Stream{mix(mix(mix(tick) ^ x) ^ y)};
+  }
+
+  // the counter is spread out before it meets the key, so neighbouring
+  // counters of one stream and the same counter of neighbouring streams
+  // don't line up
+  constexpr U32 draw(Stream stream, U32 counter) {
+    return mix(stream.key + counter * 0x9e3779b9u);
+  }
+
+  // a draw as a chance out of 256
+  constexpr U8 chance(Stream stream, U32 counter) {
+    return draw(stream, counter) >> 24;
+  }
+}
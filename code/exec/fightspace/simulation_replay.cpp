@@ -0,0 +1,294 @@
+#include "simulation_replay.h"
+
+#include "arena.h"
+#include "ds_array_dynamic.h"
+#include "types.h"
+
+#include <cassert>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+
+namespace {
+  const U32 MAGIC   = 0x43455253; // "SREC"
+  const U16 VERSION = 2;
+
+  // in place of the material byte, a push_cell with its two velocities
+  // following
+  const U8 PUSH = 0xff;
+
+  struct Header {
+    U32 magic;
+    U16 version;
+    U16 reserved;
+    U32 level_width;
+    U32 level_height;
+    U32 start_tick;
+    U32 ticks;
+  };
+
+  struct Input {
+    U32 x;
+    U32 y;
+    U8  type; // MaterialType or PUSH
+    I8  velocity_x;
+    I8  velocity_y;
+  };
+
+  bool             _recording = false;
+  DynamicArray<U8> _data;
+
+  // inputs of the tick being recorded, written out as one block when the
+  // tick changes
+  DynamicArray<Input> _pending;
+  U32                 _pending_tick = 0;
+  U32                 _last_tick    = 0;
+
+  void _put_varint(U32 value) {
+    while (value >= 0x80) {
+      array::push_back(_data, U8(value | 0x80));
+      value >>= 7;
+    }
+    array::push_back(_data, U8(value));
+  }
+
+  void _put_delta(U32 value, U32 previous) {
+    I32 delta = I32(value - previous);
+    _put_varint(U32(delta << 1) ^ U32(delta >> 31));
+  }
+
+  // reads of a loaded recording stop at end. a read past it or a varint
+  // longer than a U32 clears ok and returns 0
+  struct Reader {
+    const U8* in;
+    const U8* end;
+    bool      ok;
+  };
+
+  U8 _get_byte(Reader& reader) {
+    if (reader.in == reader.end) {
+      reader.ok = false;
+      return 0;
+    }
+
+    return *reader.in++;
+  }
+
+  U32 _get_varint(Reader& reader) {
+    U32 value = 0;
+
+    for (U8 shift = 0; shift < 35; shift += 7) {
+      U8 byte  = _get_byte(reader);
+      value   |= U32(byte & 0x7f) << shift;
+
+      if (!(byte & 0x80)) return reader.ok ? value : 0;
+    }
+
+    reader.ok = false;
+    return 0;
+  }
+
+  U32 _get_delta(Reader& reader, U32 previous) {
+    U32 zigzag = _get_varint(reader);
+    return previous + U32(I32(zigzag >> 1) ^ -I32(zigzag & 1));
+  }
+
+  Header* _header() { return reinterpret_cast<Header*>(_data._data); }
+
+  void _flush() {
+    if (_pending._size == 0) return;
+
+    _put_varint(_pending_tick - _last_tick);
+    _put_varint(_pending._size);
+
+    U32 x = 0;
+    U32 y = 0;
+
+    for (U32 i = 0; i < _pending._size; ++i) {
+      auto& input = _pending._data[i];
+
+      _put_delta(input.x, x);
+      _put_delta(input.y, y);
+      array::push_back(_data, input.type);
+
+      if (input.type == PUSH) {
+        array::push_back(_data, U8(input.velocity_x));
+        array::push_back(_data, U8(input.velocity_y));
+      }
+
+      x = input.x;
+      y = input.y;
+    }
+
+    _last_tick     = _pending_tick;
+    _pending._size = 0;
+  }
+}
+
+bool simulation::replay::start(ArenaHandle arena,
+                               U32         level_width,
+                               U32         level_height) {
+  // a playback starts from an empty level at tick 0, a recording has to
+  // as well
+  if (simulation::tick() != 0 || simulation::stats().chunks_allocated != 0) {
+    printf("recordings start right after simulation::init\n");
+    return false;
+  }
+
+  _data    = array::init<U8>(arena, 4096, sizeof(Header));
+  _pending = array::init<Input>(arena, 256);
+
+  *_header() = Header{
+      .magic        = MAGIC,
+      .version      = VERSION,
+      .level_width  = level_width,
+      .level_height = level_height,
+      .start_tick   = simulation::tick(),
+  };
+
+  _pending_tick = _last_tick = simulation::tick();
+  _recording                 = true;
+
+  return true;
+}
+
+void simulation::replay::stop() {
+  if (!_recording) return;
+
+  _flush();
+
+  _header()->ticks = simulation::tick() - _header()->start_tick;
+  _recording       = false;
+}
+
+bool simulation::replay::recording() { return _recording; }
+
+void simulation::replay::input(U32 tick, U32 x, U32 y, MaterialType type) {
+  if (tick != _pending_tick) {
+    _flush();
+    _pending_tick = tick;
+  }
+
+  array::push_back(_pending, Input{.x = x, .y = y, .type = U8(type)});
+}
+
+void simulation::replay::push(
+    U32 tick, U32 x, U32 y, I8 velocity_x, I8 velocity_y) {
+  if (tick != _pending_tick) {
+    _flush();
+    _pending_tick = tick;
+  }
+
+  array::push_back(_pending,
+                   Input{
+                       .x          = x,
+                       .y          = y,
+                       .type       = PUSH,
+                       .velocity_x = velocity_x,
+                       .velocity_y = velocity_y,
+                   });
+}
+
+const DynamicArray<U8>& simulation::replay::data() { return _data; }
+
+bool simulation::replay::save(const char* path) {
+  assert(!_recording && "Stop the recording before saving it");
+
+  std::ofstream file(path, std::ios::binary | std::ios::trunc);
+
+  if (!file.is_open()) {
+    printf("failed to open recording: '%s'\n", path);
+    return false;
+  }
+
+  file.write(reinterpret_cast<const char*>(_data._data), _data._size);
+
+  return file.good();
+}
+
+DynamicArray<U8> simulation::replay::load(ArenaHandle arena, const char* path) {
+  std::ifstream file(path, std::ios::ate | std::ios::binary);
+
+  if (!file.is_open()) {
+    printf("failed to open recording: '%s'\n", path);
+    return DynamicArray<U8>{};
+  }
+
+  U32  size      = static_cast<U32>(file.tellg());
+  auto recording = array::init<U8>(arena, size, size);
+
+  file.seekg(0);
+  file.read(reinterpret_cast<char*>(recording._data), size);
+
+  return recording;
+}
+
+U32 simulation::replay::play(const DynamicArray<U8>& recording,
+                             U8*                     gpu_memory,
+                             TickFn                  on_tick) {
+  if (recording._size < sizeof(Header)) return 0;
+
+  Header header;
+  memcpy(&header, recording._data, sizeof(Header));
+
+  if (header.magic != MAGIC || header.version != VERSION ||
+      header.start_tick != 0) {
+    printf("not a simulation recording, or an old one\n");
+    return 0;
+  }
+
+  simulation::init(0, 0, header.level_width, header.level_height, gpu_memory);
+
+  Reader reader = {
+      .in  = recording._data + sizeof(Header),
+      .end = recording._data + recording._size,
+      .ok  = true,
+  };
+
+  // inputs recorded at tick n were made before the n + 1th simulate
+  U32 next_input = reader.in < reader.end ? _get_varint(reader) : U32_MAX;
+
+  for (U32 tick = 0; tick < header.ticks; ++tick) {
+    if (tick == next_input) {
+      U32 count = _get_varint(reader);
+      U32 x     = 0;
+      U32 y     = 0;
+
+      for (U32 i = 0; i < count && reader.ok; ++i) {
+        x = _get_delta(reader, x);
+        y = _get_delta(reader, y);
+
+        U8 type = _get_byte(reader);
+
+        if (x >= header.level_width || y >= header.level_height) {
+          reader.ok = false;
+        } else if (type == PUSH) {
+          I8 velocity_x = I8(_get_byte(reader));
+          I8 velocity_y = I8(_get_byte(reader));
+
+          reader.ok = reader.ok && velocity_x >= -16 && velocity_x <= 15 &&
+                      velocity_y >= -16 && velocity_y <= 15;
+
+          if (reader.ok) simulation::push_cell(x, y, velocity_x, velocity_y);
+        } else if (type <= U8(MaterialType::FIRE)) {
+          if (reader.ok) simulation::add_cell(x, y, MaterialType(type));
+        } else {
+          reader.ok = false;
+        }
+      }
+
+      next_input = reader.in < reader.end ? tick + _get_varint(reader) : U32_MAX;
+
+      if (!reader.ok) {
+        printf("recording is cut off or corrupt at tick %u\n", tick);
+        return 0;
+      }
+    }
+
+    simulation::simulate();
+
+    if (on_tick) on_tick(tick);
+  }
+
+  return header.ticks;
+}
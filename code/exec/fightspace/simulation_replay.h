@@ -0,0 +1,42 @@
+#pragma once
+
+#include "ds_array_dynamic.h"
+#include "exec/fightspace/simulation.h"
+#include "handles.h"
+#include "types.h"
+
+// records the add_cell calls made between ticks and plays them back. with
+// the same kernels, layout and tick rules a playback reproduces the session
+// exactly, state_hash after every tick included
+//
+// a recording is a header followed by one block per tick that had input:
+// the tick as a varint delta to the previous block, the input count, and
+// per input x and y as zigzag varint deltas to the previous input and the
+// material byte, or for push_cell 0xff and the two velocities. a brush
+// stroke costs about 3 bytes per cell
+namespace simulation::replay {
+  // records into memory from arena. playback starts from an empty level,
+  // so recording has to start right after simulation::init, before any
+  // cell is added or tick simulated. returns false otherwise
+  bool start(ArenaHandle arena, U32 level_width, U32 level_height);
+  void stop();
+  bool recording();
+
+  // called by add_cell and push_cell while recording
+  void input(U32 tick, U32 x, U32 y, MaterialType type);
+  void push(U32 tick, U32 x, U32 y, I8 velocity_x, I8 velocity_y);
+
+  const DynamicArray<U8>& data();
+
+  bool             save(const char* path);
+  DynamicArray<U8> load(ArenaHandle arena, const char* path);
+
+  // inits the simulation for the recorded level and plays every recorded
+  // tick. on_tick, if set, runs after each simulate. returns the number of
+  // ticks played, 0 for a recording that is cut off or corrupt
+  typedef void (*TickFn)(U32 tick);
+
+  U32 play(const DynamicArray<U8>& recording,
+           U8*                     gpu_memory,
+           TickFn                  on_tick = nullptr);
+}
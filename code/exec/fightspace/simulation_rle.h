@@ -0,0 +1,53 @@
+#pragma once
+
+#include "types.h"
+
+#include <cstring>
+
+// run length coding for the buffers of dormant chunks. a run is a U8 length
+// minus one followed by the value, so a chunk of AIR takes 17 runs. the
+// worst case is 1 + sizeof(T) bytes per value
+namespace simulation::rle {
+  template <typename T> U32 max_bytes(U32 count) {
+    return count * (1 + sizeof(T));
+  }
+
+  // returns the number of bytes written to out
+  template <typename T> U32 encode(const T* values, U32 count, U8* out) {
+    U8* start = out;
+
+    for (U32 i = 0; i < count;) {
+      U32 run = 1;
+      while (i + run < count && run < 256 && values[i + run] == values[i]) {
+        ++run;
+      }
+
+      *out++ = static_cast<U8>(run - 1);
+      memcpy(out, &values[i], sizeof(T));
+      out += sizeof(T);
+
+      i += run;
+    }
+
+    return out - start;
+  }
+
+  // returns the number of bytes read from in
+  template <typename T> U32 decode(const U8* in, U32 count, T* values) {
+    const U8* start = in;
+
+    for (U32 i = 0; i < count;) {
+      U32 run = *in++ + 1;
+
+      T value;
+      memcpy(&value, in, sizeof(T));
+      in += sizeof(T);
+
+      for (U32 end = i + run; i < end; ++i) {
+        values[i] = value;
+      }
+    }
+
+    return in - start;
+  }
+}
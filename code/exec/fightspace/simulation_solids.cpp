@@ -0,0 +1,689 @@
+#include "simulation_solids.h"
+
+#include "arena.h"
+#include "ds_array_dynamic.h"
+#include "simulation_materials.h"
+#include "types.h"
+
+#include <algorithm>
+#include <bit>
+#include <cstring>
+#include <numeric>
+
+namespace {
+  using simulation::Body;
+  using simulation::Vertex;
+  using simulation::solids::Link;
+  using simulation::solids::NONE;
+  using simulation::solids::Solids;
+  using simulation::solids::WIDTH;
+
+  // a row holds at most every other cell as a run of its own
+  const U16 MAX_RUNS = WIDTH * WIDTH / 2;
+
+  struct Run {
+    U8  start;
+    U8  end; // inclusive
+    U16 label;
+  };
+
+  U16 _find(U16* parents, U16 run) {
+    while (parents[run] != run) {
+      parents[run] = parents[parents[run]];
+      run          = parents[run];
+    }
+
+    return run;
+  }
+
+  // the lower run stays the root, so a region's root is its first run
+  void _union(U16* parents, U16 a, U16 b) {
+    a = _find(parents, a);
+    b = _find(parents, b);
+
+    if (a < b) {
+      parents[b] = a;
+    } else {
+      parents[a] = b;
+    }
+  }
+
+  // sides of a marching square, each from one corner to the next going
+  // clockwise. corner k is the first corner of side k
+  enum Side : U8 {
+    TOP,
+    RIGHT,
+    BOTTOM,
+    LEFT,
+  };
+
+  struct Outline {
+    const U8* mask;
+    I32       width;
+    I32       height;
+  };
+
+  bool _solid(const Outline& outline, I32 x, I32 y) {
+    if (x < 0 || y < 0 || x >= outline.width || y >= outline.height) {
+      return false;
+    }
+
+    return outline.mask[y * outline.width + x] != 0;
+  }
+
+  // horizontal edges join cell centres x, y and x + 1, y for x from -1, the
+  // vertical ones x, y and x, y + 1 for y from -1
+  U32 _edge_index(const Outline& outline, I32 square_x, I32 square_y, U8 side) {
+    U32 horizontal_count = (outline.width + 1) * outline.height;
+
+    switch (side) {
+      case TOP:
+        return square_y * (outline.width + 1) + square_x + 1;
+      case BOTTOM:
+        return (square_y + 1) * (outline.width + 1) + square_x + 1;
+      case LEFT:
+        return horizontal_count + (square_y + 1) * outline.width + square_x;
+      default:
+        return horizontal_count + (square_y + 1) * outline.width + square_x +
+               1;
+    }
+  }
+
+  // the middle of a square's side in half cells, the square's top left
+  // corner is the centre of cell square_x, square_y
+  void _midpoint(I32 square_x, I32 square_y, U8 side, I32& x, I32& y) {
+    const I32 SIDE_X[] = {2, 3, 2, 1};
+    const I32 SIDE_Y[] = {1, 2, 3, 2};
+
+    x = 2 * square_x + SIDE_X[side];
+    y = 2 * square_y + SIDE_Y[side];
+  }
+
+  // follows the outline from the side entered through, with the solid on
+  // the right, until it is back at the start
+  void _trace(const Outline&        outline,
+              I32                   square_x,
+              I32                   square_y,
+              U8                    entered,
+              U8*                   visited,
+              DynamicArray<Vertex>& points) {
+    const I32 START_X    = square_x;
+    const I32 START_Y    = square_y;
+    const U8  START_SIDE = entered;
+
+    // the loop in half cells, straightened below
+    U32 first = points._size;
+
+    do {
+      bool corners[4] = {
+          _solid(outline, square_x, square_y),
+          _solid(outline, square_x + 1, square_y),
+          _solid(outline, square_x + 1, square_y + 1),
+          _solid(outline, square_x, square_y + 1),
+      };
+
+      visited[_edge_index(outline, square_x, square_y, entered)] = 1;
+
+      I32 x;
+      I32 y;
+      _midpoint(square_x, square_y, entered, x, y);
+      array::push_back(points, Vertex{F32(x), F32(y)});
+
+      bool saddle = corners[0] == corners[2] && corners[1] == corners[3] &&
+                    corners[0] != corners[1];
+
+      U8 leaving = entered;
+
+      if (saddle) {
+        // diagonal cells are not 4-connected, turn around the entered
+        // side's solid corner
+        U8 solid = corners[entered] ? entered : (entered + 1) % 4;
+        leaving  = solid == entered ? (solid + 3) % 4 : solid;
+      } else {
+        for (U8 side = 1; side < 4; ++side) {
+          U8 other = (entered + side) % 4;
+
+          if (corners[other] != corners[(other + 1) % 4]) {
+            leaving = other;
+            break;
+          }
+        }
+      }
+
+      const I32 STEP_X[] = {0, 1, 0, -1};
+      const I32 STEP_Y[] = {-1, 0, 1, 0};
+
+      square_x += STEP_X[leaving];
+      square_y += STEP_Y[leaving];
+      entered   = (leaving + 2) % 4;
+    } while (square_x != START_X || square_y != START_Y ||
+             entered != START_SIDE);
+
+    // drop the points in the middle of straight runs and go from half
+    // cells to cells. kept points move down over ones already looked at
+    U32    count    = points._size - first;
+    Vertex previous = points._data[first + count - 1];
+    Vertex start    = points._data[first];
+
+    points._size = first;
+
+    for (U32 i = 0; i < count; ++i) {
+      Vertex point = points._data[first + i];
+      Vertex next  = i + 1 < count ? points._data[first + i + 1] : start;
+
+      F32 cross = (point.x - previous.x) * (next.y - point.y) -
+                  (point.y - previous.y) * (next.x - point.x);
+
+      previous = point;
+
+      if (cross == 0.0f) continue;
+
+      points._data[points._size++] = Vertex{point.x / 2, point.y / 2};
+    }
+  }
+
+  ArenaHandle _arena;
+
+  // solids of the chunks that ever held solid cells, in the order they
+  // first did
+  DynamicArray<Solids*> _chunks;
+  U32                   _chunk_count = 0;
+
+  // union find over every region of every chunk, whether a region's root
+  // reaches the level's sides or bottom, and which body it became
+  DynamicArray<U32>  _parents;
+  DynamicArray<bool> _anchored;
+  DynamicArray<U32>  _body_of;
+
+  // a region of a chunk that belongs to a body, index is into _chunks
+  struct BodyPart {
+    U32 body;
+    U32 index;
+    U16 label;
+  };
+
+  // bodies the last update found, their outlines and what it took to trace
+  // them
+  DynamicArray<Body>     _bodies;
+  DynamicArray<Vertex>   _points;
+  DynamicArray<U32>      _loop_ends;
+  DynamicArray<BodyPart> _parts;
+  DynamicArray<U8>       _mask;
+  DynamicArray<U8>       _visited;
+
+  // pairs up the labels along one side, edge is the tile's and other_edge
+  // the neighbour's facing it
+  U8 _link_edge(const U16* edge, const U16* other_edge, Link* links) {
+    U8 count = 0;
+
+    for (U32 i = 0; i < WIDTH; ++i) {
+      if (edge[i] == NONE || other_edge[i] == NONE) continue;
+
+      Link link{edge[i], other_edge[i]};
+
+      if (count > 0 && links[count - 1].own == link.own &&
+          links[count - 1].other == link.other) {
+        continue;
+      }
+
+      links[count++] = link;
+    }
+
+    return count;
+  }
+
+  U32 _find_region(U32 node) {
+    auto parents = _parents._data;
+
+    while (parents[node] != node) {
+      parents[node] = parents[parents[node]];
+      node          = parents[node];
+    }
+
+    return node;
+  }
+
+  // the lower node stays the root, which keeps the roots independent of
+  // the order regions are joined in
+  void _join_regions(U32 a, U32 b) {
+    a = _find_region(a);
+    b = _find_region(b);
+
+    if (a < b) {
+      _parents._data[b] = a;
+    } else {
+      _parents._data[a] = b;
+    }
+  }
+
+  void _anchor_edge(const Solids* solids, const U16* edge) {
+    for (U32 i = 0; i < WIDTH; ++i) {
+      if (edge[i] == NONE) continue;
+
+      _anchored._data[_find_region(solids->base + edge[i])] = true;
+    }
+  }
+
+  // marks the cells of the body's parts in _mask, which covers the chunks
+  // from chunk_x, chunk_y on, and traces their outlines
+  void _trace_body(const BodyPart* parts,
+                   U32             part_count,
+                   U32             chunk_x,
+                   U32             chunk_y,
+                   U32             width,
+                   U32             height) {
+    const U16 MAX_COMPONENTS = WIDTH * WIDTH / 2;
+
+    U16 labels[WIDTH * WIDTH];
+    U64 wanted[MAX_COMPONENTS / 64];
+
+    auto& body = _bodies._data[parts[0].body];
+
+    body.min_x = U32_MAX;
+    body.min_y = U32_MAX;
+
+    array::resize(_mask, width * height);
+    memset(_mask._data, 0, width * height);
+
+    // a chunk's parts are next to each other, in label order
+    for (U32 first = 0; first < part_count;) {
+      auto solids = _chunks._data[parts[first].index];
+      U32  last   = first;
+
+      memset(wanted, 0, sizeof(wanted));
+
+      for (; last < part_count && parts[last].index == parts[first].index;
+           ++last) {
+        wanted[parts[last].label / 64] |= 1ull << (parts[last].label % 64);
+      }
+
+      auto tile = solids->tile;
+      simulation::solids::label(tile, labels);
+
+      U32 origin_x = (solids->x - chunk_x) * WIDTH;
+      U32 origin_y = (solids->y - chunk_y) * WIDTH;
+
+      for (U32 y = 0; y < WIDTH; ++y) {
+        for (U32 x = 0; x < WIDTH; ++x) {
+          U16 label = labels[y * WIDTH + x];
+
+          if (label == NONE) continue;
+          if (!(wanted[label / 64] & (1ull << (label % 64)))) continue;
+
+          _mask._data[(origin_y + y) * width + origin_x + x] = 1;
+
+          U32 cell_x = solids->x * WIDTH + x;
+          U32 cell_y = solids->y * WIDTH + y;
+
+          body.min_x = std::min(body.min_x, cell_x);
+          body.min_y = std::min(body.min_y, cell_y);
+          body.max_x = std::max(body.max_x, cell_x);
+          body.max_y = std::max(body.max_y, cell_y);
+          ++body.cells;
+        }
+      }
+
+      first = last;
+    }
+
+    U32 first_point = _points._size;
+    U32 first_loop  = _loop_ends._size;
+
+    array::resize(_visited, simulation::solids::outline_scratch(width, height));
+
+    simulation::solids::outline(
+        _mask._data, width, height, _visited._data, _points, _loop_ends);
+
+    for (U32 i = first_point; i < _points._size; ++i) {
+      _points._data[i].x += chunk_x * WIDTH;
+      _points._data[i].y += chunk_y * WIDTH;
+    }
+
+    for (U32 i = first_loop; i < _loop_ends._size; ++i) {
+      _loop_ends._data[i] -= first_point;
+    }
+
+    body.loop_count = _loop_ends._size - first_loop;
+  }
+
+  // traces the bodies of _body_of, then points them at their outlines
+  void _trace_bodies() {
+    _parts._size = 0;
+
+    for (U32 i = 0; i < _chunks._size; ++i) {
+      auto solids = _chunks._data[i];
+
+      for (U32 label = 0; label < solids->tile.components; ++label) {
+        U32 body = _body_of._data[_find_region(solids->base + label)];
+
+        if (body == U32_MAX) continue;
+
+        array::push_back(_parts, BodyPart{body, i, U16(label)});
+      }
+    }
+
+    std::stable_sort(
+        _parts._data,
+        _parts._data + _parts._size,
+        [](const BodyPart& a, const BodyPart& b) { return a.body < b.body; });
+
+    for (U32 first = 0; first < _parts._size;) {
+      U32 last = first;
+
+      U32 min_x = U32_MAX;
+      U32 min_y = U32_MAX;
+      U32 max_x = 0;
+      U32 max_y = 0;
+
+      for (; last < _parts._size &&
+             _parts._data[last].body == _parts._data[first].body;
+           ++last) {
+        auto solids = _chunks._data[_parts._data[last].index];
+
+        min_x = std::min(min_x, solids->x);
+        min_y = std::min(min_y, solids->y);
+        max_x = std::max(max_x, solids->x);
+        max_y = std::max(max_y, solids->y);
+      }
+
+      _trace_body(_parts._data + first,
+                  last - first,
+                  min_x,
+                  min_y,
+                  (max_x - min_x + 1) * WIDTH,
+                  (max_y - min_y + 1) * WIDTH);
+
+      first = last;
+    }
+
+    U32 point = 0;
+    U32 loop  = 0;
+
+    for (U32 i = 0; i < _bodies._size; ++i) {
+      auto& body = _bodies._data[i];
+
+      body.points    = _points._data + point;
+      body.loop_ends = _loop_ends._data + loop;
+
+      if (body.loop_count > 0) point += body.loop_ends[body.loop_count - 1];
+      loop += body.loop_count;
+    }
+  }
+}
+
+void simulation::solids::label(Tile& tile, U16* labels) {
+  Run runs[MAX_RUNS];
+  U16 parents[MAX_RUNS];
+  U16 row_starts[WIDTH + 1];
+  U16 run_count = 0;
+
+  for (U8 y = 0; y < WIDTH; ++y) {
+    row_starts[y] = run_count;
+
+    U64 bits = tile.rows[y];
+
+    // runs of the row above that may still touch a run of this one
+    U16 above     = y > 0 ? row_starts[y - 1] : 0;
+    U16 above_end = y > 0 ? row_starts[y] : 0;
+
+    while (bits) {
+      U8  start  = std::countr_zero(bits);
+      U64 ones   = ~(bits >> start);
+      U8  length = ones ? std::countr_zero(ones) : WIDTH - start;
+      U8  end    = start + length - 1;
+
+      runs[run_count]    = Run{.start = start, .end = end};
+      parents[run_count] = run_count;
+
+      while (above < above_end && runs[above].end < start) {
+        ++above;
+      }
+
+      for (U16 run = above; run < above_end && runs[run].start <= end;
+           ++run) {
+        _union(parents, run, run_count);
+      }
+
+      ++run_count;
+
+      bits = end == WIDTH - 1 ? 0 : bits & (~0ull << (end + 1));
+    }
+  }
+
+  row_starts[WIDTH] = run_count;
+
+  // roots come before the rest of their region
+  tile.components = 0;
+
+  for (U16 run = 0; run < run_count; ++run) {
+    U16 root = _find(parents, run);
+
+    runs[run].label = root == run ? tile.components++ : runs[root].label;
+  }
+
+  std::fill_n(tile.top, WIDTH, NONE);
+  std::fill_n(tile.bottom, WIDTH, NONE);
+  std::fill_n(tile.left, WIDTH, NONE);
+  std::fill_n(tile.right, WIDTH, NONE);
+
+  for (U16 run = row_starts[0]; run < row_starts[1]; ++run) {
+    std::fill(tile.top + runs[run].start,
+              tile.top + runs[run].end + 1,
+              runs[run].label);
+  }
+
+  for (U16 run = row_starts[WIDTH - 1]; run < run_count; ++run) {
+    std::fill(tile.bottom + runs[run].start,
+              tile.bottom + runs[run].end + 1,
+              runs[run].label);
+  }
+
+  for (U8 y = 0; y < WIDTH; ++y) {
+    if (row_starts[y] == row_starts[y + 1]) continue;
+
+    auto& first = runs[row_starts[y]];
+    auto& last  = runs[row_starts[y + 1] - 1];
+
+    if (first.start == 0) tile.left[y] = first.label;
+    if (last.end == WIDTH - 1) tile.right[y] = last.label;
+  }
+
+  if (!labels) return;
+
+  std::fill_n(labels, WIDTH * WIDTH, NONE);
+
+  for (U8 y = 0; y < WIDTH; ++y) {
+    for (U16 run = row_starts[y]; run < row_starts[y + 1]; ++run) {
+      std::fill(labels + y * WIDTH + runs[run].start,
+                labels + y * WIDTH + runs[run].end + 1,
+                runs[run].label);
+    }
+  }
+}
+
+U32 simulation::solids::outline_scratch(U32 width, U32 height) {
+  return (width + 1) * height + width * (height + 1);
+}
+
+void simulation::solids::outline(const U8*             mask,
+                                 U32                   width,
+                                 U32                   height,
+                                 U8*                   visited,
+                                 DynamicArray<Vertex>& points,
+                                 DynamicArray<U32>&    loop_ends) {
+  Outline outline{.mask = mask, .width = I32(width), .height = I32(height)};
+
+  memset(visited, 0, outline_scratch(width, height));
+
+  // every loop crosses a horizontal edge, start one at each edge crossed
+  // that no loop went through yet
+  for (I32 y = 0; y < outline.height; ++y) {
+    for (I32 x = -1; x < outline.width; ++x) {
+      bool solid = _solid(outline, x, y);
+
+      if (solid == _solid(outline, x + 1, y)) continue;
+
+      // the square below the edge when the solid is on its left, so the
+      // walk goes down with the solid on its right
+      I32 square_y = solid ? y : y - 1;
+      U8  entered  = solid ? TOP : BOTTOM;
+
+      if (visited[_edge_index(outline, x, square_y, entered)]) continue;
+
+      _trace(outline, x, square_y, entered, visited, points);
+      array::push_back(loop_ends, points._size);
+    }
+  }
+}
+
+void simulation::solids::init(ArenaHandle arena) {
+  _arena       = arena;
+  _chunks      = array::init<Solids*>(arena, 64);
+  _chunk_count = 0;
+
+  _parents   = array::init<U32>(arena, 256);
+  _anchored  = array::init<bool>(arena, 256);
+  _body_of   = array::init<U32>(arena, 256);
+  _bodies    = array::init<Body>(arena, 16);
+  _points    = array::init<Vertex>(arena, 256);
+  _loop_ends = array::init<U32>(arena, 16);
+  _parts     = array::init<BodyPart>(arena, 64);
+  _mask      = array::init<U8>(arena, WIDTH * WIDTH);
+  _visited   = array::init<U8>(arena, 2 * WIDTH * WIDTH);
+}
+
+Solids* simulation::solids::add(U32 x, U32 y) {
+  auto solids = arena::alloc<Solids>(_arena, sizeof(Solids));
+
+  solids->x = x;
+  solids->y = y;
+  label(solids->tile, nullptr);
+
+  array::push_back(_chunks, solids);
+
+  return solids;
+}
+
+bool simulation::solids::relabel(Solids&            solids,
+                                 const cells::Cell* buffer,
+                                 U32                min_y,
+                                 U32                max_y) {
+  U64 rows[WIDTH];
+  U32 bytes = (max_y - min_y + 1) * sizeof(U64);
+
+  // bit x of rows[y] is set for each solid cell
+  for (U32 y = min_y; y <= max_y; ++y) {
+    auto cell = buffer + y * WIDTH;
+    U64  row  = 0;
+
+    for (U32 x = 0; x < WIDTH; ++x) {
+      U8 material = U8(cells::material(cell[x]));
+
+      row |= U64((materials::SOLID >> material) & 1) << x;
+    }
+
+    rows[y] = row;
+  }
+
+  solids.relabeled =
+      memcmp(rows + min_y, solids.tile.rows + min_y, bytes) != 0;
+
+  if (!solids.relabeled) return false;
+
+  memcpy(solids.tile.rows + min_y, rows + min_y, bytes);
+  label(solids.tile, nullptr);
+
+  return true;
+}
+
+void simulation::solids::link(Solids& solids, Solids* right, Solids* below) {
+  solids.right_count = 0;
+  solids.below_count = 0;
+
+  if (right) {
+    solids.right       = right;
+    solids.right_count = _link_edge(
+        solids.tile.right, right->tile.left, solids.right_links);
+  }
+
+  if (below) {
+    solids.below       = below;
+    solids.below_count = _link_edge(
+        solids.tile.bottom, below->tile.top, solids.below_links);
+  }
+}
+
+void simulation::solids::update(Solids* const* relabeled,
+                                U32            relabeled_count,
+                                U32            chunks_x,
+                                U32            chunks_y) {
+  _bodies._size    = 0;
+  _points._size    = 0;
+  _loop_ends._size = 0;
+
+  if (relabeled_count == 0) return;
+
+  U32 node_count = 0;
+
+  _chunk_count = 0;
+
+  for (U32 i = 0; i < _chunks._size; ++i) {
+    auto solids  = _chunks._data[i];
+    solids->base = node_count;
+    node_count  += solids->tile.components;
+
+    if (solids->tile.components) ++_chunk_count;
+  }
+
+  array::resize(_parents, node_count);
+  array::resize(_anchored, node_count);
+  array::resize(_body_of, node_count);
+
+  std::iota(_parents._data, _parents._data + node_count, 0);
+  std::fill_n(_anchored._data, node_count, false);
+  std::fill_n(_body_of._data, node_count, U32_MAX);
+
+  for (U32 i = 0; i < _chunks._size; ++i) {
+    auto solids = _chunks._data[i];
+
+    for (U32 link = 0; link < solids->right_count; ++link) {
+      _join_regions(solids->base + solids->right_links[link].own,
+                    solids->right->base + solids->right_links[link].other);
+    }
+
+    for (U32 link = 0; link < solids->below_count; ++link) {
+      _join_regions(solids->base + solids->below_links[link].own,
+                    solids->below->base + solids->below_links[link].other);
+    }
+  }
+
+  // the level's sides and bottom hold what touches them
+  for (U32 i = 0; i < _chunks._size; ++i) {
+    auto solids = _chunks._data[i];
+
+    if (solids->x == 0) _anchor_edge(solids, solids->tile.left);
+    if (solids->x == chunks_x - 1) _anchor_edge(solids, solids->tile.right);
+    if (solids->y == chunks_y - 1) _anchor_edge(solids, solids->tile.bottom);
+  }
+
+  for (U32 i = 0; i < relabeled_count; ++i) {
+    auto solids = relabeled[i];
+
+    for (U32 label = 0; label < solids->tile.components; ++label) {
+      U32 root = _find_region(solids->base + label);
+
+      if (_anchored._data[root] || _body_of._data[root] != U32_MAX) continue;
+
+      _body_of._data[root] = _bodies._size;
+      array::push_back(_bodies, Body{});
+    }
+  }
+
+  if (_bodies._size > 0) _trace_bodies();
+}
+
+U32 simulation::solids::chunk_count() { return _chunk_count; }
+
+U32 simulation::solids::body_count() { return _bodies._size; }
+
+const Body* simulation::solids::bodies() { return _bodies._data; }
@@ -0,0 +1,117 @@
+#pragma once
+
+#include "ds_array_dynamic.h"
+#include "exec/fightspace/simulation.h"
+#include "exec/fightspace/simulation_cells.h"
+#include "exec/fightspace/simulation_kernels.h"
+#include "handles.h"
+#include "types.h"
+
+// connected regions of solid cells. a tile is a chunk's solids as one bit
+// per cell, labeled on its own so tiles can be labeled on any thread. the
+// edges of a tile keep the labels along its sides, which is all it takes
+// to join regions across chunks. regions joined up that do not reach the
+// level's sides or bottom are the bodies
+namespace simulation::solids {
+  const U8 WIDTH = simulation::kernels::ROW_WIDTH;
+
+  // label of a cell that is not solid
+  const U16 NONE = U16_MAX;
+
+  struct Tile {
+    // bit x of rows[y] is set for a solid cell
+    U64 rows[WIDTH];
+
+    // regions in the tile, labeled 0 to components - 1 in the order their
+    // first cell comes up row by row
+    U16 components;
+
+    // labels of the cells along each side, NONE where a cell is not solid
+    U16 top[WIDTH];
+    U16 bottom[WIDTH];
+    U16 left[WIDTH];
+    U16 right[WIDTH];
+  };
+
+  // labels the 4-connected regions of tile.rows, a union find over the runs
+  // of set bits in each row. fills in components and the edges, and every
+  // cell's label into labels unless it is nullptr
+  void label(Tile& tile, U16* labels);
+
+  // appends closed outlines around the set cells of mask, width x height
+  // bytes row by row, to points and loop_ends like Body has them. points are
+  // in cells from the mask's top left. visited needs outline_scratch bytes
+  void outline(const U8*             mask,
+               U32                   width,
+               U32                   height,
+               U8*                   visited,
+               DynamicArray<Vertex>& points,
+               DynamicArray<U32>&    loop_ends);
+
+  U32 outline_scratch(U32 width, U32 height);
+
+  // labels of a tile's regions where they touch the tile right of or below
+  // it, one link per run of touching cells
+  struct Link {
+    U16 own;
+    U16 other;
+  };
+
+  // a chunk's solids as of the last relabel and its links to the chunks
+  // right of and below it
+  struct Solids {
+    Tile tile;
+
+    // the chunk, in chunks from the level's top left
+    U32 x;
+    U32 y;
+
+    // set when the last relabel changed tile
+    bool relabeled;
+
+    // node of region 0 in the union find over all regions, the others
+    // follow it
+    U32 base;
+
+    Solids* right;
+    Solids* below;
+    Link    right_links[WIDTH];
+    Link    below_links[WIDTH];
+    U8      right_count;
+    U8      below_count;
+  };
+
+  // forgets every chunk and body, what follows allocates from arena
+  void init(ArenaHandle arena);
+
+  // the empty solids of chunk x, y, joined in from the next update on
+  Solids* add(U32 x, U32 y);
+
+  // takes rows min_y to max_y of buffer, a chunk's cells, into the tile
+  // and labels it again when they hold other solids than before. returns
+  // relabeled. runs on any thread, one call per solids at a time
+  bool relabel(Solids&            solids,
+               const cells::Cell* buffer,
+               U32                min_y,
+               U32                max_y);
+
+  // links solids with the solids right of and below it, either nullptr
+  // where there are none
+  void link(Solids& solids, Solids* right, Solids* below);
+
+  // joins the regions of every chunk through their links and turns the
+  // regions of the relabeled solids that no longer reach the sides or
+  // bottom of a level chunks_x x chunks_y chunks big into bodies, with
+  // their outlines. the last update's bodies are gone either way
+  void update(Solids* const* relabeled,
+              U32            relabeled_count,
+              U32            chunks_x,
+              U32            chunks_y);
+
+  // chunks with any region, as of the last update that relabeled any
+  U32 chunk_count();
+
+  // the last update's bodies, valid until the next one
+  U32         body_count();
+  const Body* bodies();
+}
@@ -4,6 +4,12 @@
 #define MESH_COUNT 100
 #endif
 
+// meshes of a single frame, the ui makes one per rect, text and border
+// side. handles hold the index in 12 bits, 4096 at most
+#ifndef FRAME_MESH_COUNT
+#define FRAME_MESH_COUNT 4096
+#endif
+
 #ifndef MAX_COMMAND_BUFFERS
 #define MAX_COMMAND_BUFFERS 20
 #endif
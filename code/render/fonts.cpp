@@ -55,7 +55,10 @@ FontHandle render::fonts::load(const char* fpath) {
 
   stbtt_pack_context ctx;
 
-  U8* bitmap = arena::alloc(arena::scratch(), font->bitmap_width * font->bitmap_height);
+  // the alpha bitmap is only needed until it is expanded to rgba
+  TempArena temp(arena::scratch());
+
+  U8* bitmap = arena::alloc(temp.handle, font->bitmap_width * font->bitmap_height);
 
   memset(bitmap, 0, font->bitmap_width * font->bitmap_height);
   stbtt_PackBegin(&ctx, bitmap, font->bitmap_width, font->bitmap_height, 0, 1, nullptr);
@@ -3,10 +3,12 @@
 #include "arena.h"
 #include "defines.h"
 #include "ds_array_dynamic.h"
+#include "ds_bitarray.h"
 #include "ds_hashmap.h"
-#include "ds_sparse_array.h"
 #include "handle.h"
 #include "handles.h"
+#include "lifetime.h"
+#include "pool.h"
 #include "vulkan/buffers.h"
 #include "vulkan/command_buffers.h"
 #include "vulkan/glm_includes.h"
@@ -18,6 +20,8 @@
 #define TINYOBJLOADER_IMPLEMENTATION
 #include <tiny_obj_loader/tiny_obj_loader.h>
 
+#include <utility>
+
 namespace {
   struct Mesh {
     vulkan::VertexBufferHandle vertex_buffer;
@@ -27,11 +31,67 @@ namespace {
     U32                        index_count       = 0;
     U32                        index_byte_offset = 0;
     MeshGPUConstants           gpu_constants;
+    bool                       owns_buffers = false;
   };
 
   ArenaHandle mem_render = arena::by_name("render");
 
-  auto _meshes = sparse::init16<Mesh, MESH_COUNT, MESH_COUNT>(mem_render);
+  const U8 LIFETIME_COUNT = std::to_underlying(LifeTime::COUNT);
+
+  // a pool per lifetime, the handle packs the lifetime with the slot index.
+  // a slot is reused as soon as it is freed, the live bits let a release
+  // find the meshes that are left
+  struct {
+    Pool<Mesh>                      pool;
+    BitArray<U64, FRAME_MESH_COUNT> live;
+  } _meshes[LIFETIME_COUNT] = {};
+
+  bool _pools = [] {
+    for (U8 i = 0; i < LIFETIME_COUNT; ++i) {
+      bool frame = i >= std::to_underlying(LifeTime::FRAME0);
+
+      _meshes[i].pool = pool::init<Mesh>(mem_render, frame ? FRAME_MESH_COUNT : MESH_COUNT);
+    }
+
+    return true;
+  }();
+
+  static_assert(MESH_COUNT <= FRAME_MESH_COUNT && FRAME_MESH_COUNT <= (1 << 12),
+                "Mesh handles pack the slot index in 12 bits");
+
+  MeshHandle _add(const Mesh& mesh, LifeTime lifetime) {
+    auto& meshes = _meshes[std::to_underlying(lifetime)];
+
+    // a full pool has already complained, callers get an invalid handle
+    Mesh* slot = pool::alloc(meshes.pool);
+    if (slot == nullptr) return MeshHandle{};
+
+    *slot = mesh;
+
+    U16 index = U16(pool::index(meshes.pool, slot));
+    bitarray::set(meshes.live, index);
+
+    return MeshHandle{.value = handles::pack_lifetime(index, lifetime)};
+  }
+
+  Mesh* _mesh(MeshHandle handle) {
+    U16      index;
+    LifeTime lifetime;
+    handles::unpack_lifetime(handle.value, index, lifetime);
+
+    auto& meshes = _meshes[std::to_underlying(lifetime)];
+
+    assert(bitarray::get(meshes.live, index) && "mesh was cleaned up or released");
+
+    return pool::at(meshes.pool, index);
+  }
+
+  void _cleanup_buffers(const Mesh* mesh) {
+    vulkan::vertex_buffers::cleanup(mesh->vertex_buffer);
+    if (!handles::invalid(mesh->index_buffer)) {
+      vulkan::index_buffers::cleanup(mesh->index_buffer);
+    }
+  }
 }
 
 namespace hashmap {
@@ -55,7 +115,21 @@ namespace hashmap {
   }
 }
 
-MeshHandle meshes::create(const char* fpath) {
+void meshes::reset_lifetime(LifeTime lifetime) {
+  auto& meshes = _meshes[std::to_underlying(lifetime)];
+
+  for (U32 i = 0; i < meshes.pool._carved; ++i) {
+    if (!bitarray::get(meshes.live, i)) continue;
+
+    auto mesh = pool::at(meshes.pool, i);
+    if (mesh->owns_buffers) _cleanup_buffers(mesh);
+  }
+
+  bitarray::clear_all(meshes.live);
+  pool::clear(meshes.pool);
+}
+
+MeshHandle meshes::create(const char* fpath, LifeTime lifetime) {
   tinyobj::attrib_t                attrib;
   std::vector<tinyobj::shape_t>    shapes;
   std::vector<tinyobj::material_t> materials;
@@ -66,6 +140,9 @@ MeshHandle meshes::create(const char* fpath) {
     exit(0);
   }
 
+  // the lookup and the arrays are gone once the buffers hold the mesh
+  TempArena temp(arena::scratch());
+
   auto unique_vertices = hashmap::init<vulkan::VertexTex, vulkan::VertexTex{}, U32>(
       arena::scratch(),
       shapes.size(),
@@ -99,19 +176,17 @@ MeshHandle meshes::create(const char* fpath) {
       .vertex_count  = vertices._size,
       .index_buffer  = vulkan::index_buffers::create(indices),
       .index_count   = indices._size,
+      .owns_buffers  = true,
   };
 
-  MeshHandle mesh_handle = MeshHandle{.value = sparse::next_id(_meshes)};
-
-  sparse::insert(_meshes, mesh_handle.value, mesh);
-
-  return mesh_handle;
+  return _add(mesh, lifetime);
 }
 
 MeshHandle meshes::create(vulkan::VertexBufferHandle vertex_buffer,
                           vulkan::IndexBufferHandle  index_buffer,
                           U32                        vertex_count,
-                          U32                        index_count) {
+                          U32                        index_count,
+                          LifeTime                   lifetime) {
   Mesh mesh{
       .vertex_buffer = vertex_buffer,
       .vertex_count  = vertex_count,
@@ -119,11 +194,23 @@ MeshHandle meshes::create(vulkan::VertexBufferHandle vertex_buffer,
       .index_count   = index_count,
   };
 
-  MeshHandle mesh_handle = MeshHandle{.value = sparse::next_id(_meshes)};
+  return _add(mesh, lifetime);
+}
 
-  sparse::insert(_meshes, mesh_handle.value, mesh);
+MeshHandle meshes::adopt(vulkan::VertexBufferHandle vertex_buffer,
+                         vulkan::IndexBufferHandle  index_buffer,
+                         U32                        vertex_count,
+                         U32                        index_count,
+                         LifeTime                   lifetime) {
+  Mesh mesh{
+      .vertex_buffer = vertex_buffer,
+      .vertex_count  = vertex_count,
+      .index_buffer  = index_buffer,
+      .index_count   = index_count,
+      .owns_buffers  = true,
+  };
 
-  return mesh_handle;
+  return _add(mesh, lifetime);
 }
 
 MeshHandle meshes::create(vulkan::VertexBufferHandle vertex_buffer,
@@ -131,7 +218,8 @@ MeshHandle meshes::create(vulkan::VertexBufferHandle vertex_buffer,
                           U32                        vertex_count,
                           U32                        index_count,
                           U32                        vertex_byte_offset,
-                          U32                        index_byte_offset) {
+                          U32                        index_byte_offset,
+                          LifeTime                   lifetime) {
   Mesh mesh{
       .vertex_buffer      = vertex_buffer,
       .vertex_count       = vertex_count,
@@ -141,42 +229,44 @@ MeshHandle meshes::create(vulkan::VertexBufferHandle vertex_buffer,
       .index_byte_offset  = index_byte_offset,
   };
 
-  MeshHandle mesh_handle = MeshHandle{.value = sparse::next_id(_meshes)};
-
-  sparse::insert(_meshes, mesh_handle.value, mesh);
-
-  return mesh_handle;
+  return _add(mesh, lifetime);
 }
 
 void meshes::set_constants(MeshHandle handle, glm::mat4 model, I32 texture_index) {
-  auto mesh = sparse::value(_meshes, handle.value);
+  if (handles::invalid(handle)) return;
+
+  auto mesh = _mesh(handle);
 
   mesh->gpu_constants = {model, texture_index};
 }
 
 void meshes::cleanup(MeshHandle handle, bool cleanup_buffers) {
-  auto mesh = sparse::value(_meshes, handle.value);
+  if (handles::invalid(handle)) return;
 
-  if (cleanup_buffers) {
-    vulkan::vertex_buffers::cleanup(mesh->vertex_buffer);
-    if (!handles::invalid(mesh->index_buffer)) {
-      vulkan::index_buffers::cleanup(mesh->index_buffer);
-    }
-  }
+  auto mesh = _mesh(handle);
+
+  if (cleanup_buffers) _cleanup_buffers(mesh);
+
+  U16      index;
+  LifeTime lifetime;
+  handles::unpack_lifetime(handle.value, index, lifetime);
 
-  sparse::remove(_meshes, handle.value);
+  auto& meshes = _meshes[std::to_underlying(lifetime)];
+
+  bitarray::clear(meshes.live, index);
+  pool::free(meshes.pool, mesh);
 }
 
 void meshes::draw(vulkan::PipelineHandle      pipeline,
                   vulkan::CommandBufferHandle command_buffer,
                   MeshHandle                  handle) {
-  auto mesh = sparse::value(_meshes, handle.value);
-
-  if (!mesh) {
+  if (handles::invalid(handle)) {
     printf("MeshHandle not found");
     exit(0);
   }
 
+  auto mesh = _mesh(handle);
+
   VkBuffer vertex_buffers[] = {
       *vulkan::buffers::vk_buffer(mesh->vertex_buffer),
   };
@@ -2,6 +2,7 @@
 
 #include "ds_array_dynamic.h"
 #include "handles.h"
+#include "lifetime.h"
 #include "vulkan/handles.h"
 #include "vulkan/index_buffers.h"
 #include "vulkan/vertex_buffers.h"
@@ -17,19 +18,30 @@ struct alignas(16) MeshGPUConstants {
 };
 
 namespace meshes {
+  // drops every mesh of the lifetime, with the buffers of the ones that own
+  // theirs. registered with lifetime::on_release by render::init
   void reset_lifetime(LifeTime lifetime);
 
-  MeshHandle create(const char* fpath);
+  // meshes made from a file or from vertices own their buffers. create with
+  // buffer handles leaves them to the caller, adopt takes them over
+  MeshHandle create(const char* fpath, LifeTime lifetime = LifeTime::FULL);
   MeshHandle create(vulkan::VertexBufferHandle vertex_buffer,
                     vulkan::IndexBufferHandle  index_buffer,
                     U32                        vertex_count,
-                    U32                        index_count);
+                    U32                        index_count,
+                    LifeTime                   lifetime = LifeTime::FULL);
   MeshHandle create(vulkan::VertexBufferHandle vertex_buffer,
                     vulkan::IndexBufferHandle  index_buffer,
                     U32                        vertex_count,
                     U32                        index_count,
                     U32                        vertex_byte_offset,
-                    U32                        index_byte_offset);
+                    U32                        index_byte_offset,
+                    LifeTime                   lifetime = LifeTime::FULL);
+  MeshHandle adopt(vulkan::VertexBufferHandle vertex_buffer,
+                   vulkan::IndexBufferHandle  index_buffer,
+                   U32                        vertex_count,
+                   U32                        index_count,
+                   LifeTime                   lifetime = LifeTime::FULL);
 
   void cleanup(MeshHandle handle, bool cleanup_buffers = true);
 
@@ -44,38 +56,46 @@ namespace meshes {
   MeshHandle create(const VertexT* vertices,
                     const U32      vertices_size,
                     const U32*     indices,
-                    const U32      indices_size) {
-    return create(vulkan::vertex_buffers::create(static_cast<const void*>(vertices),
-                                                 vertices_size * sizeof(VertexT)),
-                  vulkan::index_buffers::create(indices, indices_size),
-                  vertices_size,
-                  indices_size);
+                    const U32      indices_size,
+                    LifeTime       lifetime = LifeTime::FULL) {
+    return adopt(vulkan::vertex_buffers::create(static_cast<const void*>(vertices),
+                                                vertices_size * sizeof(VertexT)),
+                 vulkan::index_buffers::create(indices, indices_size),
+                 vertices_size,
+                 indices_size,
+                 lifetime);
   }
 
   template <typename VertexT>
   MeshHandle create(const VertexT* vertices,
-                    const U32      vertices_size) {
-    return create(vulkan::vertex_buffers::create(static_cast<const void*>(vertices),
-                                                 vertices_size * sizeof(VertexT)),
-                  vulkan::IndexBufferHandle(),
-                  vertices_size,
-                  0);
+                    const U32      vertices_size,
+                    LifeTime       lifetime = LifeTime::FULL) {
+    return adopt(vulkan::vertex_buffers::create(static_cast<const void*>(vertices),
+                                                vertices_size * sizeof(VertexT)),
+                 vulkan::IndexBufferHandle(),
+                 vertices_size,
+                 0,
+                 lifetime);
   }
 
   template <typename VertexT>
   MeshHandle
-  create(DynamicArray<VertexT>& vertices, DynamicArray<U32>& indices = S_DARRAY(VertexT)) {
+  create(DynamicArray<VertexT>& vertices,
+         DynamicArray<U32>&     indices  = S_DARRAY(VertexT),
+         LifeTime               lifetime = LifeTime::FULL) {
     if (indices._size == 0) {
-      return create(vulkan::vertex_buffers::create(vertices),
-                    vulkan::IndexBufferHandle(),
-                    vertices._size,
-                    0);
+      return adopt(vulkan::vertex_buffers::create(vertices),
+                   vulkan::IndexBufferHandle(),
+                   vertices._size,
+                   0,
+                   lifetime);
     }
 
-    return create(vulkan::vertex_buffers::create(vertices),
-                  vulkan::index_buffers::create(indices),
-                  vertices._size,
-                  indices._size);
+    return adopt(vulkan::vertex_buffers::create(vertices),
+                 vulkan::index_buffers::create(indices),
+                 vertices._size,
+                 indices._size,
+                 lifetime);
   }
 
 }
@@ -4,6 +4,7 @@
 #include "ds_array_dynamic.h"
 #include "frame.h"
 #include "handles.h"
+#include "lifetimes.h"
 #include "meshes.h"
 #include "ui.h"
 #include "vulkan/command_buffers.h"
@@ -47,6 +48,8 @@ void render::init(Settings settings, SDL_Window* sdl_window) {
 
   frame::init(vulkan::_ctx.logical_device);
 
+  lifetime::on_release(meshes::reset_lifetime);
+
   arena::reset(arena::scratch());
 }
 
@@ -101,7 +104,7 @@ void render::begin_frame() {
   vkWaitForFences(vulkan::_ctx.logical_device, 1, &frame::current->fence, VK_TRUE, UINT64_MAX);
 
   arena::set_frame(frame::current->index);
-  arena::reset(frame::current->arena);
+  lifetime::release(lifetime::frame(frame::current->index));
 
   auto result = vkAcquireNextImageKHR(vulkan::_ctx.logical_device,
                                       vulkan::_swap_chain.swap_chain,
@@ -1,12 +1,14 @@
 #include "ui.h"
 
 #include "arena.h"
+#include "defines.h"
 #include "ds_array_dynamic.h"
 #include "ds_array_static.h"
 #include "ds_string.h"
 #include "fonts.h"
 #include "frame.h"
 #include "handles.h"
+#include "lifetimes.h"
 #include "meshes.h"
 #include "render.h"
 #include "vulkan/buffers.h"
@@ -50,6 +52,7 @@ namespace {
     vulkan::IndexBufferHandle  index_buffer;
     U32*                       index_mapped_memory;
     U64                        index_offset;
+    U32                        mesh_count;
   } _ui_frames[3];
 
   struct Rect {
@@ -59,12 +62,18 @@ namespace {
     F32 h;
   };
 
+  // meshes have the frame's lifetime like their part of the buffers, the
+  // frame's release in render::begin_frame drops them all. past
+  // FRAME_MESH_COUNT meshes a frame the rest of the ui is not drawn
   MeshHandle _create_mesh(vulkan::Vertex2DColorTex* vertices,
                           U32                       vertex_count,
                           U32*                      indices,
                           U32                       index_count) {
     auto current_ui_frame = &_ui_frames[render::frame::current->index];
 
+    if (current_ui_frame->mesh_count == FRAME_MESH_COUNT) return MeshHandle{};
+    ++current_ui_frame->mesh_count;
+
     memcpy(current_ui_frame->vertex_mapped_memory + current_ui_frame->vertex_offset,
            vertices,
            vertex_count * sizeof(vulkan::Vertex2DColorTex));
@@ -81,7 +90,8 @@ namespace {
                        vertex_count,
                        index_count,
                        current_ui_frame->vertex_offset * sizeof(vulkan::Vertex2DColorTex),
-                       current_ui_frame->index_offset * sizeof(U32));
+                       current_ui_frame->index_offset * sizeof(U32),
+                       lifetime::frame(render::frame::current->index));
 
     current_ui_frame->vertex_offset += vertex_count;
     current_ui_frame->index_offset += index_count;
@@ -324,8 +334,7 @@ namespace {
     indices[index_count++] = 3; // LT
 
     auto mesh = _create_mesh(vertices, total_vertices, indices, total_indices);
-    render::draw(mesh);
-    meshes::cleanup(mesh, false);
+    if (!handles::invalid(mesh)) render::draw(mesh);
   }
 
   void draw_fill_rect(const Rect rect, glm::vec4 color) {
@@ -339,8 +348,7 @@ namespace {
     U32 indices[] = {0, 3, 1, 1, 3, 2};
 
     auto mesh = _create_mesh(vertices, 4, indices, 6);
-    render::draw(mesh);
-    meshes::cleanup(mesh, false);
+    if (!handles::invalid(mesh)) render::draw(mesh);
   }
 
   void draw_arc(const glm::vec2 center,
@@ -390,8 +398,7 @@ namespace {
     }
 
     auto mesh = _create_mesh(vertices._data, vertices._size, indices._data, indices._size);
-    render::draw(mesh);
-    meshes::cleanup(mesh, false);
+    if (!handles::invalid(mesh)) render::draw(mesh);
   }
 
   void draw_border(Rect& rect, Clay_BorderRenderData* clay_data) {
@@ -602,6 +609,7 @@ void draw_text(Rect& rect, Clay_TextRenderData& clay_data) {
   }
 
   auto mesh = _create_mesh(vertices, vertex_count, indices, indices_count);
+  if (handles::invalid(mesh)) return;
 
   float     scale = clay_data.fontSize / font.pixel_height;
   glm::mat4 model = glm::translate(glm::mat4(1.0f), glm::vec3(rect.x, rect.y, 0.0f)) *
@@ -609,7 +617,6 @@ void draw_text(Rect& rect, Clay_TextRenderData& clay_data) {
   meshes::set_constants(mesh, model, 0);
 
   render::draw(mesh);
-  meshes::cleanup(mesh, false);
 }
 
 void ui::init(SDL_Window*              sdl_window,
@@ -637,7 +644,7 @@ void ui::init(SDL_Window*              sdl_window,
   U64        mem_size    = Clay_MinMemorySize();
   Clay_Arena clay_memory = {
       .capacity = mem_size,
-      .memory   = arena::alloc<char>(mem_render, mem_size),
+      .memory   = arena::alloc_uninit<char>(mem_render, mem_size),
   };
 
   int width, height;
@@ -688,6 +695,7 @@ void ui::draw_frame() {
 
   _ui_frames[render::frame::current->index].vertex_offset = 0;
   _ui_frames[render::frame::current->index].index_offset  = 0;
+  _ui_frames[render::frame::current->index].mesh_count    = 0;
 
   auto clay_commands = _ui_builder_fn();
 
@@ -0,0 +1,144 @@
+#include "arena.h"
+#include "ds_sparse_array.h"
+#include "exec/fightspace/simulation.h"
+#include "jobs.h"
+#include "pool.h"
+#include "types.h"
+
+#include <catch2/benchmark/catch_benchmark.hpp>
+#include <catch2/catch_test_macros.hpp>
+#include <cstring>
+#include <string>
+#include <thread>
+
+ARENA_INIT(scratch, 1000000);
+ARENA_INIT(threads, 100000000);
+ARENA_INIT(shared_bench, 10000000);
+ARENA_INIT(pool_bench, 10000000);
+
+namespace {
+  const U32 JOB_COUNT   = 64;
+  const U32 ALLOC_COUNT = 1024;
+  const U32 ALLOC_SIZE  = 32;
+
+  // a level of 16 x 16 chunks
+  const U32 CHUNKS_ACROSS = 16;
+
+  // about the size of a mesh, which the ui creates and frees every draw
+  struct Item {
+    U64 data[14];
+  };
+
+  const U32 ITEM_COUNT = 1024;
+}
+
+TEST_CASE("arena_alloc_threads", "[ARENA]") {
+  U32 max_threads = std::thread::hardware_concurrency();
+  if (max_threads == 0) max_threads = 1;
+
+  auto shared = arena::by_name("shared_bench");
+  arena::share(shared);
+
+  for (U32 thread_count = 1; thread_count <= max_threads; ++thread_count) {
+    jobs::init(thread_count);
+
+    std::string threads = " " + std::to_string(thread_count) + " threads";
+
+    BENCHMARK("64k allocs shared arena" + threads) {
+      arena::reset(shared);
+
+      jobs::parallel_for(JOB_COUNT, [](U32) {
+        auto handle = arena::by_name("shared_bench");
+
+        for (U32 i = 0; i < ALLOC_COUNT; ++i) {
+          arena::alloc(handle, ALLOC_SIZE);
+        }
+      });
+    };
+
+    BENCHMARK("64k allocs thread scratch" + threads) {
+      jobs::parallel_for(JOB_COUNT, [](U32) {
+        auto handle = arena::scratch();
+
+        for (U32 i = 0; i < ALLOC_COUNT; ++i) {
+          arena::alloc(handle, ALLOC_SIZE);
+        }
+
+        arena::reset(handle);
+      });
+    };
+
+    jobs::cleanup();
+  }
+}
+
+// a cell in every chunk of a new level, so the time is mostly allocating
+// chunks and filling their blocks. the level arena is the one
+// bench_simulation.cpp sets up
+TEST_CASE("arena_chunk_init", "[ARENA]") {
+  const U32 LEVEL_SIZE = CHUNKS_ACROSS * 64;
+
+  printf("%u chunks of %u bytes\n",
+         CHUNKS_ACROSS * CHUNKS_ACROSS,
+         simulation::chunk_bytes());
+
+  BENCHMARK("256 chunks created") {
+    arena::reset(arena::by_name("level"));
+    simulation::init(0, 0, LEVEL_SIZE, LEVEL_SIZE, nullptr);
+
+    for (U32 y = 0; y < CHUNKS_ACROSS; ++y) {
+      for (U32 x = 0; x < CHUNKS_ACROSS; ++x) {
+        simulation::add_cell(x * 64 + 32, y * 64 + 32, MaterialType::SAND);
+      }
+    }
+
+    return simulation::stats().chunks_allocated;
+  };
+}
+
+TEST_CASE("pool_alloc_free", "[POOL]") {
+  auto handle = arena::by_name("pool_bench");
+
+  auto sparse = sparse::init16<Item, ITEM_COUNT, ITEM_COUNT>(handle);
+  auto items  = pool::init<Item>(handle, ITEM_COUNT);
+
+  U16   ids[ITEM_COUNT];
+  Item* values[ITEM_COUNT];
+
+  BENCHMARK("1024 items sparse insert and remove") {
+    for (U32 i = 0; i < ITEM_COUNT; ++i) {
+      ids[i] = sparse::next_id(sparse);
+      sparse::insert(sparse, ids[i], Item{.data = {i}});
+    }
+
+    for (U32 i = 0; i < ITEM_COUNT; ++i) {
+      sparse::remove(sparse, ids[i]);
+    }
+  };
+
+  BENCHMARK("1024 items pool alloc and free") {
+    for (U32 i = 0; i < ITEM_COUNT; ++i) {
+      values[i]  = pool::alloc(items);
+      *values[i] = Item{.data = {i}};
+    }
+
+    for (U32 i = 0; i < ITEM_COUNT; ++i) {
+      pool::free(items, values[i]);
+    }
+  };
+
+  PoolCache<Item> cache = {};
+
+  BENCHMARK("1024 items pool alloc and free through a cache") {
+    for (U32 i = 0; i < ITEM_COUNT; ++i) {
+      values[i]  = pool::alloc(items, cache);
+      *values[i] = Item{.data = {i}};
+    }
+
+    for (U32 i = 0; i < ITEM_COUNT; ++i) {
+      pool::free(items, cache, values[i]);
+    }
+  };
+
+  pool::flush(items, cache);
+}
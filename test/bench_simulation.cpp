@@ -0,0 +1,362 @@
+#include "arena.h"
+#include "exec/fightspace/simulation.h"
+#include "exec/fightspace/simulation_kernels.h"
+#include "jobs.h"
+#include "types.h"
+
+#include <catch2/benchmark/catch_benchmark.hpp>
+#include <catch2/catch_test_macros.hpp>
+#include <chrono>
+#include <cstdio>
+#include <string>
+#include <thread>
+#include <vector>
+
+ARENA_INIT(level, 400000000);
+ARENA_INIT(checkpoints, 200000000);
+
+namespace {
+  const U32 LEVEL_WIDTH  = 1024;
+  const U32 LEVEL_HEIGHT = 1024;
+
+  U8 gpu_memory[192 * 108];
+
+  const char* KERNEL_NAMES[] = {"scalar", "sse2", "avx2", "avx512"};
+
+  void init_sand_level() {
+    arena::reset(arena::by_name("level"));
+
+    simulation::init(0, 0, LEVEL_WIDTH, LEVEL_HEIGHT, gpu_memory);
+
+    for (U32 y = 0; y < LEVEL_HEIGHT; y += 2) {
+      for (U32 x = 0; x < LEVEL_WIDTH; x += 3) {
+        simulation::add_cell(x, y, MaterialType::SAND);
+      }
+    }
+  }
+}
+
+TEST_CASE("simulation_thread_scaling", "[SIMULATION]") {
+  U32 max_threads = std::thread::hardware_concurrency();
+  if (max_threads == 0) max_threads = 1;
+
+  for (U32 thread_count = 1; thread_count <= max_threads; ++thread_count) {
+    jobs::init(thread_count);
+    init_sand_level();
+
+    BENCHMARK("simulate 1024x1024 " + std::to_string(thread_count) +
+              " threads") {
+      simulation::simulate();
+    };
+
+    jobs::cleanup();
+  }
+}
+
+TEST_CASE("simulation_settled_world", "[SIMULATION]") {
+  jobs::init(1);
+  init_sand_level();
+
+  BENCHMARK("simulate 1024x1024 falling sand") { simulation::simulate(); };
+
+  for (U32 i = 0; i < LEVEL_HEIGHT && simulation::stats().chunks_awake > 0;
+       ++i) {
+    simulation::simulate();
+  }
+
+  BENCHMARK("simulate 1024x1024 settled") { simulation::simulate(); };
+
+  jobs::cleanup();
+}
+
+// built once per cell layout, as benchmarks and benchmarks_packed
+TEST_CASE("simulation_cell_layout", "[SIMULATION]") {
+#ifdef SIMULATION_PACKED_CELLS
+  const char* layout = "packed";
+#else
+  const char* layout = "planar";
+#endif
+
+  printf("%s cells: %u bytes per chunk\n", layout, simulation::chunk_bytes());
+
+  jobs::init(1);
+  init_sand_level();
+
+  BENCHMARK("simulate 1024x1024 " + std::string(layout) + " cells") {
+    simulation::simulate();
+  };
+
+  jobs::cleanup();
+}
+
+TEST_CASE("simulation_dormant_chunks", "[SIMULATION]") {
+  jobs::init(1);
+  init_sand_level();
+
+  for (U32 i = 0; i < LEVEL_HEIGHT * 2; ++i) {
+    simulation::simulate();
+  }
+
+  auto& stats = simulation::stats();
+
+  printf("%u dormant chunks: %u bytes compressed, ratio %.1f\n",
+         stats.chunks_compressed,
+         stats.compressed_bytes,
+         double(stats.chunks_compressed) * simulation::chunk_bytes() /
+             stats.compressed_bytes);
+
+  // reading a cell wakes its chunk
+  U32 decompressed  = stats.chunks_decompressed;
+  U64 decompress_ns = stats.decompress_ns;
+
+  for (U32 y = 0; y < LEVEL_HEIGHT; y += 64) {
+    for (U32 x = 0; x < LEVEL_WIDTH; x += 64) {
+      simulation::cell(x, y);
+    }
+  }
+
+  printf("wake latency: %.0f ns per chunk\n",
+         double(stats.decompress_ns - decompress_ns) /
+             (stats.chunks_decompressed - decompressed));
+
+  jobs::cleanup();
+}
+
+TEST_CASE("simulation_checkpoints", "[SIMULATION]") {
+  jobs::init(1);
+
+  for (U32 width : {1024u, 4096u}) {
+    arena::reset(arena::by_name("level"));
+    arena::reset(arena::by_name("checkpoints"));
+
+    simulation::init(0, 0, width, width, nullptr);
+    simulation::set_checkpoints(arena::by_name("checkpoints"), 2);
+
+    // a stone floor through every chunk, settled
+    for (U32 y = 32; y < width; y += 64) {
+      for (U32 x = 0; x < width; ++x) {
+        simulation::add_cell(x, y, MaterialType::STONE);
+      }
+    }
+
+    do {
+      simulation::simulate();
+    } while (simulation::stats().chunks_awake);
+
+    auto started = std::chrono::steady_clock::now();
+    U32  full    = simulation::checkpoint();
+    auto full_ms = std::chrono::duration<F64, std::milli>(
+                       std::chrono::steady_clock::now() - started)
+                       .count();
+    U32 full_chunks = simulation::stats().checkpoint_chunks;
+
+    // sand poured onto one row of chunks
+    for (U32 tick = 0; tick < 30; ++tick) {
+      for (U32 x = 0; x < width; x += 4) {
+        simulation::add_cell(x, 64, MaterialType::SAND);
+      }
+
+      simulation::simulate();
+    }
+
+    started = std::chrono::steady_clock::now();
+    simulation::checkpoint();
+    auto incremental_ms = std::chrono::duration<F64, std::milli>(
+                              std::chrono::steady_clock::now() - started)
+                              .count();
+    U32 incremental_chunks = simulation::stats().checkpoint_chunks;
+
+    started = std::chrono::steady_clock::now();
+    REQUIRE(simulation::rollback(full));
+    auto rollback_ms = std::chrono::duration<F64, std::milli>(
+                           std::chrono::steady_clock::now() - started)
+                           .count();
+
+    printf("%u chunks: full checkpoint %.3f ms, %u chunks changed %.3f ms, "
+           "rollback %.3f ms\n",
+           full_chunks,
+           full_ms,
+           incremental_chunks,
+           incremental_ms,
+           rollback_ms);
+  }
+
+  jobs::cleanup();
+}
+
+TEST_CASE("simulation_particles", "[SIMULATION]") {
+  const U32 PARTICLES = 100000;
+
+  jobs::init();
+
+  arena::reset(arena::by_name("level"));
+  simulation::init(0, 0, LEVEL_WIDTH, LEVEL_HEIGHT, nullptr);
+
+  // a floor of sand 1000 cells wide thrown up at once
+  for (U32 y = LEVEL_HEIGHT - PARTICLES / 1000; y < LEVEL_HEIGHT; ++y) {
+    for (U32 x = 12; x < 1012; ++x) {
+      simulation::add_cell(x, y, MaterialType::SAND);
+      simulation::push_cell(x, y, I8(x % 3) - 1, -16);
+    }
+  }
+
+  simulation::simulate();
+
+  auto launch_ms = simulation::stats().particle_ns / 1e6;
+
+  REQUIRE(simulation::stats().particles_launched == PARTICLES);
+
+  // about 60 ticks until the first ones land
+  const U32 TICKS = 40;
+
+  U64 flight_ns = 0;
+
+  for (U32 i = 0; i < TICKS; ++i) {
+    simulation::simulate();
+    flight_ns += simulation::stats().particle_ns;
+  }
+
+  auto flight_ms = flight_ns / 1e6 / TICKS;
+
+  REQUIRE(simulation::stats().particles == PARTICLES);
+
+  printf("%u particles: launch %.3f ms, flight %.3f ms per tick, "
+         "%.1f ns each\n",
+         PARTICLES,
+         launch_ms,
+         flight_ms,
+         flight_ms * 1e6 / PARTICLES);
+
+  jobs::cleanup();
+}
+
+TEST_CASE("simulation_heat", "[SIMULATION]") {
+  jobs::init();
+
+  // the same small fire in a small and a large world of stone, heat should
+  // only cost what is warm
+  for (U32 size : {1024u, 4096u}) {
+    arena::reset(arena::by_name("level"));
+    simulation::init(0, 0, size, size, nullptr);
+
+    for (U32 y = 0; y < size; ++y) {
+      for (U32 x = 0; x < size; ++x) {
+        simulation::add_cell(x, y, MaterialType::STONE);
+      }
+    }
+
+    for (U32 y = size / 2 - 16; y < size / 2 + 16; ++y) {
+      for (U32 x = size / 2 - 16; x < size / 2 + 16; ++x) {
+        simulation::add_cell(x, y, MaterialType::WOOD);
+      }
+    }
+
+    simulation::add_cell(size / 2, size / 2, MaterialType::FIRE);
+
+    const U32 TICKS = 200;
+
+    U64 heat_ns     = 0;
+    U32 heat_chunks = 0;
+
+    for (U32 i = 0; i < TICKS; ++i) {
+      simulation::simulate();
+      heat_ns     += simulation::stats().heat_ns;
+      heat_chunks += simulation::stats().heat_chunks;
+    }
+
+    printf("%ux%u: %.1f warm chunks, heat %.3f ms per tick\n",
+           size,
+           size,
+           F32(heat_chunks) / TICKS,
+           heat_ns / 1e6 / TICKS);
+  }
+
+  jobs::cleanup();
+}
+
+TEST_CASE("simulation_bodies", "[SIMULATION]") {
+  const U32 SIZE   = 2048;
+  const U32 CHUNKS = SIZE / 64;
+
+  jobs::init();
+
+  arena::reset(arena::by_name("level"));
+  simulation::init(0, 0, SIZE, SIZE, nullptr);
+
+  for (U32 y = 0; y < SIZE; ++y) {
+    for (U32 x = 0; x < SIZE; ++x) {
+      simulation::add_cell(x, y, MaterialType::STONE);
+    }
+  }
+
+  simulation::simulate();
+
+  // knocks a cell out of the middle of count chunks and puts it back, so
+  // every tick relabels count chunks of a world of CHUNKS * CHUNKS
+  for (U32 count : {1u, 16u, 64u, 256u, 1024u}) {
+    const U32 TICKS = 20;
+
+    U64 label_ns = 0;
+
+    for (U32 i = 0; i < TICKS; ++i) {
+      auto material = i % 2 ? MaterialType::STONE : MaterialType::AIR;
+
+      for (U32 chunk = 0; chunk < count; ++chunk) {
+        simulation::add_cell((chunk % CHUNKS) * 64 + 32,
+                             (chunk / CHUNKS) * 64 + 32,
+                             material);
+      }
+
+      simulation::simulate();
+
+      REQUIRE(simulation::stats().chunks_labeled == count);
+
+      label_ns += simulation::stats().label_ns;
+    }
+
+    printf("%u of %u solid chunks changed: label %.3f ms per tick\n",
+           count,
+           simulation::stats().solid_chunks,
+           label_ns / 1e6 / TICKS);
+  }
+
+  jobs::cleanup();
+}
+
+TEST_CASE("simulation_row_kernels", "[SIMULATION]") {
+  const U32 CELLS = 64 * 64;
+
+  // every other row is mostly sand so each row pair has something to move
+  std::vector<simulation::cells::Cell> source(
+      CELLS, simulation::cells::make(MaterialType::AIR));
+  for (U32 i = 0; i < CELLS; ++i) {
+    if ((i / 64) % 2 == 0 && i % 3 != 0) {
+      source[i] = simulation::cells::make(MaterialType::SAND);
+    }
+  }
+
+  for (U8 kernel = 0; kernel <= U8(simulation::kernels::best()); ++kernel) {
+    auto fall_row = simulation::kernels::fall_row(simulation::Kernel(kernel));
+
+    BENCHMARK_ADVANCED("fall kernel " + std::string(KERNEL_NAMES[kernel]) +
+                       " 3968 cells")(Catch::Benchmark::Chronometer meter) {
+      std::vector<simulation::cells::Cell> back(CELLS);
+
+      meter.measure([&] {
+        auto cells = source.data();
+        U64  moved = 0;
+
+        for (U32 y = 1; y < 63; ++y) {
+          moved |= fall_row(cells + (y - 1) * 64,
+                            cells + y * 64,
+                            cells + (y + 1) * 64,
+                            back.data() + y * 64,
+                            0,
+                            63);
+        }
+
+        return moved;
+      });
+    };
+  }
+}
@@ -0,0 +1,427 @@
+#include "arena.h"
+#include "jobs.h"
+#include "lifetimes.h"
+#include "pool.h"
+#include "types.h"
+
+#include <atomic>
+#include <chrono>
+#include <catch2/catch_test_macros.hpp>
+#include <cstring>
+#include <thread>
+#include <utility>
+
+ARENA_INIT(scratch, 1000000);
+ARENA_INIT(threads, 10000000);
+ARENA_INIT(shared_test, 1000000);
+ARENA_INIT(temp_test, 10000);
+ARENA_INIT(stats_test, 10000);
+ARENA_INIT(pool_test, 1000000);
+ARENA_INIT(render, 10000);
+ARENA_INIT(frame0, 10000);
+ARENA_INIT(frame1, 10000);
+ARENA_INIT(frame2, 10000);
+
+namespace {
+  const U32 JOB_COUNT   = 64;
+  const U32 BLOCK_COUNT = 100;
+  const U32 BLOCK_SIZE  = 24;
+
+  U8* _blocks[JOB_COUNT][BLOCK_COUNT];
+
+  // fills every block with its job's index, so two jobs handed overlapping
+  // memory would overwrite each other
+  void fill(U32 job, ArenaHandle handle) {
+    for (U32 i = 0; i < BLOCK_COUNT; ++i) {
+      _blocks[job][i] = arena::alloc(handle, BLOCK_SIZE);
+      memset(_blocks[job][i], job + 1, BLOCK_SIZE);
+    }
+  }
+
+  bool filled() {
+    for (U32 job = 0; job < JOB_COUNT; ++job) {
+      for (U32 i = 0; i < BLOCK_COUNT; ++i) {
+        for (U32 byte = 0; byte < BLOCK_SIZE; ++byte) {
+          if (_blocks[job][i][byte] != job + 1) return false;
+        }
+      }
+    }
+
+    return true;
+  }
+}
+
+namespace {
+  const U32 RUN_COUNT = 64;
+
+  std::atomic<U32> _runs[RUN_COUNT];
+  std::atomic<U32> _running{0};
+
+  void count_run(U32 index) {
+    ++_running;
+    std::this_thread::sleep_for(std::chrono::microseconds(50));
+    ++_runs[index];
+    --_running;
+  }
+
+  // every index ran once and nothing is still running when parallel_for
+  // returns
+  bool ran_once() {
+    bool once = _running == 0;
+
+    for (U32 i = 0; i < RUN_COUNT; ++i) {
+      once  = once && _runs[i] == 1;
+      _runs[i] = 0;
+    }
+
+    return once;
+  }
+}
+
+// workers of a restarted pool must not take the last pool's pass for a new
+// one
+TEST_CASE("jobs_restart", "[JOBS]") {
+  for (U32 i = 0; i < 200; ++i) {
+    jobs::init(4);
+
+    jobs::parallel_for(RUN_COUNT, count_run);
+    REQUIRE(ran_once());
+
+    jobs::cleanup();
+    jobs::init(4);
+
+    jobs::parallel_for(RUN_COUNT, count_run);
+    REQUIRE(ran_once());
+
+    jobs::cleanup();
+  }
+}
+
+TEST_CASE("arena_shared", "[ARENA]") {
+  auto handle = arena::by_name("shared_test");
+  arena::share(handle);
+  arena::reset(handle);
+
+  jobs::init(4);
+
+  jobs::parallel_for(JOB_COUNT,
+                     [](U32 job) { fill(job, arena::by_name("shared_test")); });
+
+  jobs::cleanup();
+
+  REQUIRE(filled());
+}
+
+TEST_CASE("arena_thread_scratch", "[ARENA]") {
+  jobs::init(4);
+
+  // jobs run on the calling thread too, it keeps the global scratch
+  jobs::parallel_for(JOB_COUNT, [](U32 job) { fill(job, arena::scratch()); });
+
+  jobs::cleanup();
+
+  REQUIRE(filled());
+
+  ArenaHandle first;
+  ArenaHandle second;
+
+  std::thread([&] {
+    arena::init_thread();
+    first = arena::scratch();
+  }).join();
+
+  std::thread([&] {
+    arena::init_thread();
+    second = arena::scratch();
+  }).join();
+
+  // a thread takes over the slot and arenas of one that exited
+  REQUIRE(first != arena::scratch());
+  REQUIRE(first == second);
+}
+
+TEST_CASE("arena_thread_frame", "[ARENA]") {
+  U8*         first;
+  U8*         next;
+  U8*         again;
+  ArenaHandle frame0;
+  ArenaHandle frame1;
+
+  std::thread([&] {
+    arena::init_thread();
+
+    arena::set_frame(0);
+    frame0 = arena::frame();
+    first  = arena::alloc(frame0, 64);
+    next   = arena::alloc(arena::frame(), 64);
+
+    arena::set_frame(1);
+    frame1 = arena::frame();
+
+    arena::set_frame(0);
+    again = arena::alloc(arena::frame(), 64);
+  }).join();
+
+  REQUIRE(next != first);
+  REQUIRE(frame1 != frame0);
+
+  // coming back to a frame starts it empty
+  REQUIRE(again == first);
+}
+
+TEST_CASE("arena_reserve", "[ARENA]") {
+  const U64 SIZE = U64(1) << 34;
+
+  auto handle = arena::reserve("reserve_test", SIZE);
+
+  // the last allocation grows in place far past the first commit
+  U8* first = arena::alloc(handle, 1000);
+  memset(first, 1, 1000);
+
+  U8* grown = arena::resize(handle, first, 1000, 100 * arena::COMMIT_SIZE);
+
+  REQUIRE(grown == first);
+  REQUIRE(grown[999] == 1);
+  REQUIRE(grown[1000] == 0);
+  REQUIRE(grown[100 * arena::COMMIT_SIZE - 1] == 0);
+
+  U8* next = arena::alloc(handle, arena::COMMIT_SIZE * 3);
+  REQUIRE(next >= grown + 100 * arena::COMMIT_SIZE);
+
+  arena::reset(handle);
+  REQUIRE(arena::alloc(handle, 8) == first);
+
+  auto huge = arena::reserve("reserve_huge_test", SIZE, true);
+  U8*  ptr  = arena::alloc(huge, 8);
+
+  REQUIRE(reinterpret_cast<uintptr_t>(ptr) % arena::HUGE_COMMIT_SIZE == 0);
+}
+
+TEST_CASE("arena_reserve_shared", "[ARENA]") {
+  auto handle = arena::reserve("reserve_shared_test", U64(1) << 30);
+  arena::share(handle);
+
+  jobs::init(4);
+
+  jobs::parallel_for(JOB_COUNT, [](U32 job) {
+    fill(job, arena::by_name("reserve_shared_test"));
+  });
+
+  jobs::cleanup();
+
+  REQUIRE(filled());
+}
+
+TEST_CASE("arena_temp_scopes", "[ARENA]") {
+  auto handle = arena::by_name("temp_test");
+  arena::reset(handle);
+
+  U8* kept = arena::alloc(handle, 16);
+  U8* freed;
+
+  {
+    TempArena outer(handle);
+    freed = arena::alloc(handle, 64);
+
+    {
+      TempArena inner(handle);
+      arena::alloc(handle, 1000);
+    }
+
+    // the inner scope's memory is handed out again
+    REQUIRE(arena::alloc(handle, 8) == freed + 64);
+  }
+
+#ifndef NDEBUG
+  REQUIRE(freed[0] == arena::POISON);
+#endif
+
+  REQUIRE(kept[15] == 0);
+  REQUIRE(arena::alloc(handle, 64) == freed);
+
+  // the mark keeps the last allocation, so it can still grow in place
+  U8* last = arena::alloc(handle, 32);
+  {
+    TempArena temp(handle);
+  }
+  REQUIRE(arena::resize(handle, last, 32, 64) == last);
+}
+
+TEST_CASE("arena_stats", "[ARENA]") {
+  auto handle = arena::by_name("stats_test");
+
+  arena::alloc(handle, 3, 1);
+  arena::alloc(handle, 8);
+  arena::alloc(handle, 8);
+
+  auto stats = arena::stats(handle);
+
+  REQUIRE(strcmp(stats.name, "stats_test") == 0);
+  REQUIRE(stats.allocs == 3);
+  REQUIRE(stats.bytes == 19);
+  REQUIRE(stats.wasted == 5);
+  REQUIRE(stats.used == 24);
+  REQUIRE(stats.capacity == 10000);
+
+  {
+    TempArena temp(handle);
+    arena::alloc(handle, 1000);
+  }
+
+  stats = arena::stats(handle);
+
+  REQUIRE(stats.used == 24);
+  REQUIRE(stats.peak == 1024);
+
+#ifdef ARENA_TRACK_SITES
+  for (U32 i = 0; i < 10; ++i) {
+    arena::alloc(handle, 200);
+  }
+
+  ArenaSite sites[2];
+
+  REQUIRE(arena::sites(handle, sites, 2) == 2);
+  REQUIRE(sites[0].allocs == 10);
+  REQUIRE(sites[0].bytes == 2000);
+  REQUIRE(sites[1].bytes == 1000);
+  REQUIRE(strstr(sites[0].file, "test_arena.cpp") != nullptr);
+#endif
+
+  arena::dump();
+}
+
+namespace {
+  LifeTime _released[4];
+  U32      _release_count = 0;
+
+  void on_release_first(LifeTime lifetime) { _released[_release_count++] = lifetime; }
+
+  // hooks run last to first, this one sees the memory before the arena resets
+  void on_release_second(LifeTime lifetime) {
+    REQUIRE(arena::stats(lifetime::arena(lifetime)).used > 0);
+
+    on_release_first(lifetime);
+  }
+}
+
+TEST_CASE("lifetime_release", "[ARENA]") {
+  REQUIRE(lifetime::arena(LifeTime::FRAME2) == arena::by_name("frame2"));
+  REQUIRE(lifetime::frame(2) == LifeTime::FRAME2);
+
+  lifetime::on_release(on_release_first);
+  lifetime::on_release(on_release_second);
+
+  auto values = lifetime::alloc<U32>(LifeTime::FRAME2, 4 * sizeof(U32));
+  REQUIRE(values[3] == 0);
+
+  lifetime::release(LifeTime::FRAME2);
+
+  REQUIRE(_release_count == 2);
+  REQUIRE(_released[0] == LifeTime::FRAME2);
+  REQUIRE(_released[1] == LifeTime::FRAME2);
+  REQUIRE(arena::stats(arena::by_name("frame2")).used == 0);
+
+  U16      index;
+  LifeTime lifetime;
+  handles::unpack_lifetime(handles::pack_lifetime(U16(77), LifeTime::LEVEL), index, lifetime);
+
+  REQUIRE(index == 77);
+  REQUIRE(lifetime == LifeTime::LEVEL);
+}
+
+// every lifetime has an arena that is set up. level is the one
+// test_simulation.cpp sets up
+TEST_CASE("lifetime_arenas", "[ARENA]") {
+  for (U8 i = 0; i < std::to_underlying(LifeTime::COUNT); ++i) {
+    auto lifetime = LifeTime(i);
+    auto used     = arena::stats(lifetime::arena(lifetime)).used;
+
+    REQUIRE(lifetime::alloc(lifetime, 16) != nullptr);
+    REQUIRE(arena::stats(lifetime::arena(lifetime)).used >= used + 16);
+  }
+
+  REQUIRE(lifetime::arena(LifeTime::FULL) == arena::by_name("render"));
+}
+
+TEST_CASE("pool_alloc_free", "[POOL]") {
+  struct Item {
+    U32 a;
+    U64 b;
+  };
+
+  auto items = pool::init<Item>(arena::by_name("pool_test"), 4);
+
+  Item* slots[4];
+
+  for (U32 i = 0; i < 4; ++i) {
+    slots[i]  = pool::alloc(items);
+    *slots[i] = Item{.a = i, .b = i * 10u};
+
+    REQUIRE(pool::index(items, slots[i]) == i);
+    REQUIRE(pool::at(items, i) == slots[i]);
+  }
+
+  // freed slots come back last in, first out
+  pool::free(items, slots[1]);
+  pool::free(items, slots[2]);
+
+  REQUIRE(pool::alloc(items) == slots[2]);
+  REQUIRE(pool::alloc(items) == slots[1]);
+  REQUIRE(slots[3]->b == 30);
+
+  auto& stats = items._stats;
+
+  REQUIRE(stats.live == 4);
+  REQUIRE(stats.peak == 4);
+  REQUIRE(stats.allocs == 6);
+  REQUIRE(stats.frees == 2);
+
+  pool::clear(items);
+
+  REQUIRE(stats.live == 0);
+  REQUIRE(pool::alloc(items) == slots[0]);
+}
+
+namespace {
+  const U32 POOL_JOB_ITEMS = 100;
+
+  Pool<U64>        _items;
+  std::atomic<U32> _overwritten{0};
+
+  // every job keeps its values alive until it is done, two jobs handed the
+  // same slot would see each other's
+  void use_pool(U32 job) {
+    PoolCache<U64> cache = {};
+    U64*           values[POOL_JOB_ITEMS];
+
+    for (U32 round = 0; round < 4; ++round) {
+      for (U32 i = 0; i < POOL_JOB_ITEMS; ++i) {
+        values[i]  = pool::alloc(_items, cache);
+        *values[i] = U64(job) << 32 | i;
+      }
+
+      for (U32 i = 0; i < POOL_JOB_ITEMS; ++i) {
+        if (*values[i] != (U64(job) << 32 | i)) ++_overwritten;
+
+        pool::free(_items, cache, values[i]);
+      }
+    }
+
+    pool::flush(_items, cache);
+  }
+}
+
+TEST_CASE("pool_thread_caches", "[POOL]") {
+  _items = pool::init<U64>(arena::by_name("pool_test"), JOB_COUNT * POOL_JOB_ITEMS);
+
+  jobs::init(4);
+  jobs::parallel_for(JOB_COUNT, use_pool);
+  jobs::cleanup();
+
+  auto& stats = _items._stats;
+
+  REQUIRE(_overwritten == 0);
+  REQUIRE(stats.live == 0);
+  REQUIRE(stats.allocs == stats.frees);
+  REQUIRE(stats.refills > 0);
+}
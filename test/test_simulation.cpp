@@ -0,0 +1,692 @@
+#include "arena.h"
+#include "exec/fightspace/simulation.h"
+#include "exec/fightspace/simulation_kernels.h"
+#include "exec/fightspace/simulation_random.h"
+#include "exec/fightspace/simulation_replay.h"
+#include "jobs.h"
+#include "types.h"
+
+#include <algorithm>
+#include <catch2/catch_test_macros.hpp>
+#include <cmath>
+#include <cstdio>
+#include <vector>
+
+ARENA_INIT(level, 100000000);
+ARENA_INIT(replay, 1000000);
+ARENA_INIT(checkpoints, 20000000);
+
+namespace {
+  const U32 LEVEL_WIDTH  = 256;
+  const U32 LEVEL_HEIGHT = 256;
+
+  U8 gpu_memory[192 * 108];
+
+  std::vector<U64> played_hashes;
+
+  void record_hash(U32 tick) {
+    played_hashes.push_back(simulation::state_hash());
+  }
+
+  void init_level() {
+    arena::reset(arena::by_name("level"));
+
+    simulation::init(0, 0, LEVEL_WIDTH, LEVEL_HEIGHT, gpu_memory);
+
+    for (U32 y = 0; y < LEVEL_HEIGHT; ++y) {
+      for (U32 x = 0; x < LEVEL_WIDTH; ++x) {
+        if ((x * 7 + y * 13) % 5 == 0) {
+          simulation::add_cell(x, y, MaterialType::SAND);
+        }
+      }
+    }
+  }
+
+  U32 count(const std::vector<MaterialType>& cells, MaterialType type) {
+    return std::count(cells.begin(), cells.end(), type);
+  }
+
+  // water and sand poured in rows that reach chunks no earlier tick touched
+  void pour(U32 tick) {
+    if (tick % 5 != 0) return;
+
+    for (U32 i = 0; i < 16; ++i) {
+      simulation::add_cell((tick * 11 + i * 3) % LEVEL_WIDTH,
+                           (tick * 3) % (LEVEL_HEIGHT / 2),
+                           tick % 2 ? MaterialType::SAND : MaterialType::WATER);
+    }
+  }
+
+  std::vector<MaterialType> level_cells() {
+    std::vector<MaterialType> cells;
+    for (U32 y = 0; y < LEVEL_HEIGHT; ++y) {
+      for (U32 x = 0; x < LEVEL_WIDTH; ++x) {
+        cells.push_back(simulation::cell(x, y));
+      }
+    }
+
+    return cells;
+  }
+
+  // a water tank with a sand pile poured into it, and a burning wooden wall
+  std::vector<MaterialType> run_materials(bool parallel, U32 ticks) {
+    arena::reset(arena::by_name("level"));
+    simulation::init(0, 0, LEVEL_WIDTH, LEVEL_HEIGHT, gpu_memory);
+    simulation::set_parallel(parallel);
+
+    for (U32 y = 100; y < 160; ++y) {
+      for (U32 x = 40; x < 100; ++x) {
+        simulation::add_cell(x, y, MaterialType::WATER);
+      }
+      for (U32 x = 60; x < 70; ++x) {
+        simulation::add_cell(x, y - 80, MaterialType::SAND);
+      }
+    }
+
+    for (U32 y = 200; y < LEVEL_HEIGHT; ++y) {
+      simulation::add_cell(180, y, MaterialType::WOOD);
+      simulation::add_cell(181, y, MaterialType::WOOD);
+    }
+    simulation::add_cell(182, 200, MaterialType::FIRE);
+
+    for (U32 i = 0; i < ticks; ++i) {
+      simulation::simulate();
+    }
+
+    return level_cells();
+  }
+
+  std::vector<MaterialType>
+  run(bool parallel, U32 ticks, simulation::Kernel kernel) {
+    init_level();
+
+    simulation::set_parallel(parallel);
+    simulation::set_kernel(kernel);
+
+    for (U32 i = 0; i < ticks; ++i) {
+      simulation::simulate();
+    }
+
+    return level_cells();
+  }
+}
+
+TEST_CASE("simulation_parallel", "[SIMULATION]") {
+  jobs::init(4);
+
+  auto serial   = run(false, 40, simulation::kernels::best());
+  auto parallel = run(true, 40, simulation::kernels::best());
+
+  jobs::cleanup();
+
+  REQUIRE(serial == parallel);
+}
+
+TEST_CASE("simulation_kernels", "[SIMULATION]") {
+  auto scalar = run(false, 40, simulation::Kernel::SCALAR);
+
+  for (U8 kernel = 1; kernel <= U8(simulation::kernels::best()); ++kernel) {
+    REQUIRE(scalar == run(false, 40, simulation::Kernel(kernel)));
+  }
+}
+
+TEST_CASE("simulation_materials", "[SIMULATION]") {
+  jobs::init(4);
+
+  auto serial   = run_materials(false, 1500);
+  auto parallel = run_materials(true, 1500);
+
+  jobs::cleanup();
+
+  REQUIRE(serial == parallel);
+
+  // nothing is lost on the way down or sideways
+  REQUIRE(count(serial, MaterialType::WATER) == 60 * 60);
+  REQUIRE(count(serial, MaterialType::SAND) == 10 * 60);
+
+  // the water spread over the floor and the sand sank to the bottom of it
+  for (U32 x = 0; x < LEVEL_WIDTH; ++x) {
+    REQUIRE(serial[30 * LEVEL_WIDTH + x] == MaterialType::AIR);
+  }
+  REQUIRE(serial[(LEVEL_HEIGHT - 1) * LEVEL_WIDTH + 65] == MaterialType::SAND);
+
+  // the wall burned down
+  REQUIRE(count(serial, MaterialType::WOOD) == 0);
+  REQUIRE(count(serial, MaterialType::FIRE) == 0);
+}
+
+TEST_CASE("simulation_chunk_borders", "[SIMULATION]") {
+  arena::reset(arena::by_name("level"));
+  simulation::init(0, 0, LEVEL_WIDTH, LEVEL_HEIGHT, gpu_memory);
+  simulation::set_parallel(false);
+
+  // falls through the chunk rows at 64, 128 and 192
+  simulation::add_cell(70, 60, MaterialType::SAND);
+
+  for (U32 i = 0; i < 10; ++i) {
+    simulation::simulate();
+  }
+
+  REQUIRE(simulation::cell(70, 60) == MaterialType::AIR);
+  REQUIRE(simulation::cell(70, 70) == MaterialType::SAND);
+
+  for (U32 i = 0; i < LEVEL_HEIGHT; ++i) {
+    simulation::simulate();
+  }
+
+  REQUIRE(simulation::cell(70, LEVEL_HEIGHT - 1) == MaterialType::SAND);
+  REQUIRE(simulation::stats().chunks_awake == 0);
+}
+
+TEST_CASE("simulation_large_world", "[SIMULATION]") {
+  const U32 SIZE = 1024 * 64; // 1024x1024 chunks
+
+  arena::reset(arena::by_name("level"));
+  simulation::init(0, 0, SIZE, SIZE, gpu_memory);
+  simulation::set_parallel(false);
+
+  REQUIRE(simulation::stats().chunks_allocated == 0);
+
+  simulation::add_cell(SIZE - 100, SIZE - 100, MaterialType::SAND);
+
+  for (U32 i = 0; i < 120; ++i) {
+    simulation::simulate();
+  }
+
+  REQUIRE(simulation::cell(SIZE - 100, SIZE - 1) == MaterialType::SAND);
+  REQUIRE(simulation::cell(SIZE - 100, SIZE - 100) == MaterialType::AIR);
+  REQUIRE(simulation::cell(10, 10) == MaterialType::AIR);
+
+  // only the chunks the sand fell through, and their neighbours
+  REQUIRE(simulation::stats().chunks_allocated <= 6);
+  REQUIRE(simulation::stats().chunks_awake == 0);
+}
+
+TEST_CASE("simulation_sleeping_chunks", "[SIMULATION]") {
+  init_level();
+
+  simulation::set_parallel(false);
+
+  for (U32 i = 0; i < LEVEL_HEIGHT * 2; ++i) {
+    simulation::simulate();
+  }
+
+  REQUIRE(simulation::stats().chunks_awake == 0);
+
+  simulation::add_cell(100, 100, MaterialType::SAND);
+  simulation::simulate();
+
+  REQUIRE(simulation::stats().chunks_updated == 1);
+}
+
+TEST_CASE("simulation_dormant_chunks", "[SIMULATION]") {
+  init_level();
+
+  simulation::set_parallel(false);
+
+  for (U32 i = 0; i < LEVEL_HEIGHT * 2; ++i) {
+    simulation::simulate();
+  }
+
+  // reading every cell wakes the compressed chunks
+  auto settled = level_cells();
+
+  REQUIRE(simulation::stats().chunks_compressed == 0);
+
+  for (U32 i = 0; i < 61; ++i) {
+    simulation::simulate();
+  }
+
+  auto& stats = simulation::stats();
+
+  // everything but the 3x2 chunks in view
+  REQUIRE(stats.chunks_compressed == 16 - 6);
+  REQUIRE(stats.compressed_bytes * 2 <=
+          stats.chunks_compressed * simulation::chunk_bytes());
+
+  U32 decompressed = stats.chunks_decompressed;
+
+  REQUIRE(level_cells() == settled);
+  REQUIRE(stats.chunks_decompressed == decompressed + 16 - 6);
+
+  simulation::simulate();
+
+  REQUIRE(stats.chunks_awake == 0);
+}
+
+TEST_CASE("simulation_gpu_upload", "[SIMULATION]") {
+  init_level();
+
+  simulation::set_parallel(false);
+
+  simulation::simulate();
+
+  REQUIRE(simulation::stats().gpu_bytes_uploaded > 0);
+
+  for (U32 y = 0; y < 108; ++y) {
+    for (U32 x = 0; x < 192; ++x) {
+      REQUIRE(gpu_memory[y * 192 + x] ==
+              static_cast<U8>(simulation::cell(x, y)));
+    }
+  }
+
+  for (U32 i = 0; i < LEVEL_HEIGHT * 2; ++i) {
+    simulation::simulate();
+  }
+
+  REQUIRE(simulation::stats().gpu_bytes_uploaded == 0);
+}
+
+TEST_CASE("simulation_streaming", "[SIMULATION]") {
+  const U32   WIDTH     = 64 * 32;
+  const U32   HEIGHT    = 64 * 4;
+  const char* PAGE_FILE = "simulation_pages.bin";
+
+  arena::reset(arena::by_name("level"));
+  simulation::init(0, 0, WIDTH, HEIGHT, gpu_memory);
+  simulation::set_parallel(false);
+
+  for (U32 y = 0; y < HEIGHT; y += 3) {
+    for (U32 x = 0; x < WIDTH; x += 2) {
+      simulation::add_cell(x, y, MaterialType::SAND);
+    }
+  }
+
+  // chunks are paged out as they go to sleep, before they are compressed
+  REQUIRE(simulation::set_streaming(PAGE_FILE, 1, 1));
+
+  for (U32 i = 0; i < HEIGHT * 2; ++i) {
+    simulation::simulate();
+  }
+
+  REQUIRE(simulation::stats().chunks_awake == 0);
+
+  std::vector<MaterialType> settled;
+  for (U32 y = 0; y < HEIGHT; ++y) {
+    for (U32 x = 0; x < WIDTH; ++x) {
+      settled.push_back(simulation::cell(x, y));
+    }
+  }
+
+  simulation::simulate();
+  simulation::simulate();
+
+  U32 resident = simulation::stats().chunks_resident;
+
+  REQUIRE(resident < simulation::stats().chunks_allocated);
+  REQUIRE(simulation::stats().pages_written > 0);
+
+  simulation::set_view(WIDTH - 192, 0);
+  simulation::simulate();
+  simulation::simulate();
+
+  REQUIRE(simulation::stats().chunks_resident <= resident);
+
+  std::vector<MaterialType> streamed;
+  for (U32 y = 0; y < HEIGHT; ++y) {
+    for (U32 x = 0; x < WIDTH; ++x) {
+      streamed.push_back(simulation::cell(x, y));
+    }
+  }
+
+  REQUIRE(settled == streamed);
+
+  simulation::init(0, 0, LEVEL_WIDTH, LEVEL_HEIGHT, nullptr);
+  std::remove(PAGE_FILE);
+}
+
+TEST_CASE("simulation_fixed_tick", "[SIMULATION]") {
+  arena::reset(arena::by_name("level"));
+  simulation::init(0, 0, LEVEL_WIDTH, LEVEL_HEIGHT, nullptr);
+  simulation::set_tick_rate(64);
+
+  REQUIRE(simulation::advance(1.0 / 128) == 0);
+  REQUIRE(simulation::advance(1.0 / 128) == 1);
+  REQUIRE(simulation::advance(3.0 / 64) == 3);
+
+  // a long stall runs a few ticks and drops the rest
+  REQUIRE(simulation::advance(10.0) == 4);
+  REQUIRE(simulation::advance(0.0) == 0);
+  REQUIRE(simulation::tick() == 8);
+
+  simulation::set_tick_rate(60);
+}
+
+TEST_CASE("simulation_replay", "[SIMULATION]") {
+  const char* RECORDING = "simulation_replay.bin";
+
+  arena::reset(arena::by_name("level"));
+  arena::reset(arena::by_name("replay"));
+
+  simulation::init(0, 0, LEVEL_WIDTH, LEVEL_HEIGHT, gpu_memory);
+  simulation::set_parallel(false);
+  REQUIRE(simulation::replay::start(arena::by_name("replay"),
+                                    LEVEL_WIDTH,
+                                    LEVEL_HEIGHT));
+
+  std::vector<U64> hashes;
+
+  for (U32 tick = 0; tick < 300; ++tick) {
+    if (tick % 7 == 0 && tick < 200) {
+      for (U32 i = 0; i < 16; ++i) {
+        simulation::add_cell(20 + (tick * 13 + i * 5) % 200,
+                             10 + i,
+                             tick % 2 ? MaterialType::SAND
+                                      : MaterialType::WATER);
+      }
+    }
+
+    simulation::simulate();
+    hashes.push_back(simulation::state_hash());
+  }
+
+  simulation::replay::stop();
+
+  REQUIRE(simulation::replay::data()._size < 30 * 16 * 4);
+  REQUIRE(simulation::replay::save(RECORDING));
+
+  auto recording =
+      simulation::replay::load(arena::by_name("replay"), RECORDING);
+  std::remove(RECORDING);
+
+  // played back in parallel against the serial recording
+  jobs::init(4);
+  simulation::set_parallel(true);
+
+  arena::reset(arena::by_name("level"));
+  played_hashes.clear();
+
+  REQUIRE(simulation::replay::play(recording, gpu_memory, record_hash) == 300);
+
+  jobs::cleanup();
+
+  REQUIRE(played_hashes == hashes);
+  REQUIRE(hashes.front() != hashes.back());
+
+  // cut off in the middle of the inputs
+  recording._size /= 2;
+  arena::reset(arena::by_name("level"));
+
+  REQUIRE(simulation::replay::play(recording, gpu_memory) == 0);
+
+  // a level that already has cells can't be played back from empty
+  REQUIRE_FALSE(simulation::replay::start(arena::by_name("replay"),
+                                          LEVEL_WIDTH,
+                                          LEVEL_HEIGHT));
+}
+
+TEST_CASE("simulation_checkpoints", "[SIMULATION]") {
+  arena::reset(arena::by_name("level"));
+  arena::reset(arena::by_name("checkpoints"));
+
+  simulation::init(0, 0, LEVEL_WIDTH, LEVEL_HEIGHT, gpu_memory);
+  simulation::set_checkpoints(arena::by_name("checkpoints"), 3);
+
+  for (U32 x = 0; x < LEVEL_WIDTH; ++x) {
+    simulation::add_cell(x, LEVEL_HEIGHT - 40, MaterialType::WOOD);
+  }
+  simulation::add_cell(LEVEL_WIDTH / 2, LEVEL_HEIGHT - 41, MaterialType::FIRE);
+
+  U32 first = simulation::checkpoint();
+  REQUIRE(simulation::stats().checkpoint_chunks ==
+          simulation::stats().chunks_allocated);
+
+  std::vector<U64> hashes;
+  U32              ids[3];
+  U64              hashes_at[3];
+  auto             cells_at = level_cells();
+
+  for (U32 tick = 0; tick < 120; ++tick) {
+    if (tick % 40 == 0) {
+      ids[tick / 40]       = simulation::checkpoint();
+      hashes_at[tick / 40] = simulation::state_hash();
+
+      if (tick == 40) cells_at = level_cells();
+    }
+
+    pour(tick);
+    simulation::simulate();
+    hashes.push_back(simulation::state_hash());
+  }
+
+  // only chunks changed since the previous checkpoint are copied
+  REQUIRE(simulation::stats().checkpoint_chunks <
+          simulation::stats().chunks_allocated);
+
+  // the ring holds three, the first checkpoint was dropped
+  REQUIRE(!simulation::rollback(first));
+
+  REQUIRE(simulation::rollback(ids[1]));
+  REQUIRE(simulation::tick() == 40);
+  REQUIRE(simulation::state_hash() == hashes_at[1]);
+  REQUIRE(level_cells() == cells_at);
+
+  // the same inputs give the same ticks again
+  for (U32 tick = 40; tick < 120; ++tick) {
+    pour(tick);
+    simulation::simulate();
+    REQUIRE(simulation::state_hash() == hashes[tick]);
+  }
+
+  // rolling back further drops the checkpoints in between
+  REQUIRE(simulation::rollback(ids[0]));
+  REQUIRE(simulation::state_hash() == hashes_at[0]);
+  REQUIRE(!simulation::rollback(ids[2]));
+
+  for (U32 tick = 0; tick < 120; ++tick) {
+    pour(tick);
+    simulation::simulate();
+    REQUIRE(simulation::state_hash() == hashes[tick]);
+  }
+}
+
+namespace {
+  // a block of sand thrown up and sideways out of a sand floor
+  std::vector<U64> run_particles(bool parallel) {
+    arena::reset(arena::by_name("level"));
+    simulation::init(0, 0, LEVEL_WIDTH, LEVEL_HEIGHT, gpu_memory);
+    simulation::set_parallel(parallel);
+
+    for (U32 y = LEVEL_HEIGHT - 64; y < LEVEL_HEIGHT; ++y) {
+      for (U32 x = 0; x < LEVEL_WIDTH; ++x) {
+        simulation::add_cell(x, y, MaterialType::SAND);
+      }
+    }
+
+    for (U32 y = LEVEL_HEIGHT - 64; y < LEVEL_HEIGHT - 32; ++y) {
+      for (U32 x = 96; x < 160; ++x) {
+        simulation::push_cell(x, y, I8(x / 8) - 16, -16);
+      }
+    }
+
+    std::vector<U64> hashes;
+
+    simulation::simulate();
+    REQUIRE(simulation::stats().particles_launched == 64 * 32);
+
+    for (U32 i = 0; i < LEVEL_HEIGHT * 2; ++i) {
+      simulation::simulate();
+      hashes.push_back(simulation::state_hash());
+    }
+
+    return hashes;
+  }
+}
+
+TEST_CASE("simulation_particles", "[SIMULATION]") {
+  jobs::init(4);
+
+  auto serial = run_particles(false);
+
+  REQUIRE(simulation::stats().particles == 0);
+  REQUIRE(count(level_cells(), MaterialType::SAND) ==
+          LEVEL_WIDTH * 64);
+
+  auto parallel = run_particles(true);
+
+  jobs::cleanup();
+
+  REQUIRE(serial == parallel);
+}
+
+TEST_CASE("simulation_heat", "[SIMULATION]") {
+  arena::reset(arena::by_name("level"));
+  simulation::init(0, 0, LEVEL_WIDTH, LEVEL_HEIGHT, gpu_memory);
+  simulation::set_parallel(false);
+
+  // nothing burning, nothing to heat
+  for (U32 i = 0; i < 100; ++i) {
+    simulation::simulate();
+  }
+  REQUIRE(simulation::stats().heat_chunks == 0);
+
+  // a block of wood across four chunks, lit in one corner
+  for (U32 y = 100; y < 140; ++y) {
+    for (U32 x = 40; x < 90; ++x) {
+      simulation::add_cell(x, y, MaterialType::WOOD);
+    }
+  }
+  simulation::add_cell(40, 100, MaterialType::FIRE);
+
+  simulation::simulate();
+  REQUIRE(simulation::stats().heat_chunks > 0);
+  REQUIRE(simulation::stats().heat_chunks < 9);
+
+  for (U32 i = 0; i < 1500; ++i) {
+    simulation::simulate();
+  }
+
+  auto cells = level_cells();
+  REQUIRE(count(cells, MaterialType::WOOD) == 0);
+  REQUIRE(count(cells, MaterialType::FIRE) == 0);
+
+  // and everything cools off again
+  for (U32 i = 0; i < 1500; ++i) {
+    simulation::simulate();
+  }
+  REQUIRE(simulation::stats().heat_chunks == 0);
+
+  simulation::set_parallel(true);
+}
+
+namespace {
+  // twice the area of a loop, the sign gives its winding
+  F32 loop_area(const simulation::Vertex* points, U32 count) {
+    F32 area = 0.0f;
+
+    for (U32 i = 0; i < count; ++i) {
+      auto& point = points[i];
+      auto& next  = points[(i + 1) % count];
+
+      area += point.x * next.y - next.x * point.y;
+    }
+
+    return area;
+  }
+}
+
+TEST_CASE("simulation_bodies", "[SIMULATION]") {
+  arena::reset(arena::by_name("level"));
+  simulation::init(0, 0, LEVEL_WIDTH, LEVEL_HEIGHT, gpu_memory);
+  simulation::set_parallel(false);
+
+  // a floor, a pillar standing on it and a slab with a hole on the pillar,
+  // all across chunk borders
+  for (U32 x = 0; x < LEVEL_WIDTH; ++x) {
+    simulation::add_cell(x, LEVEL_HEIGHT - 1, MaterialType::STONE);
+  }
+
+  for (U32 y = 150; y < LEVEL_HEIGHT - 1; ++y) {
+    for (U32 x = 100; x < 104; ++x) {
+      simulation::add_cell(x, y, MaterialType::STONE);
+    }
+  }
+
+  for (U32 y = 120; y < 150; ++y) {
+    for (U32 x = 40; x < 140; ++x) {
+      bool hole = x >= 60 && x < 70 && y >= 130 && y < 140;
+
+      if (!hole) simulation::add_cell(x, y, MaterialType::WOOD);
+    }
+  }
+
+  simulation::simulate();
+
+  REQUIRE(simulation::body_count() == 0);
+  REQUIRE(simulation::stats().solid_chunks > 4);
+
+  // cut the pillar, everything above the cut comes loose
+  for (U32 x = 100; x < 104; ++x) {
+    simulation::add_cell(x, 200, MaterialType::AIR);
+  }
+
+  simulation::simulate();
+
+  REQUIRE(simulation::body_count() == 1);
+
+  auto& body = simulation::bodies()[0];
+
+  REQUIRE(body.min_x == 40);
+  REQUIRE(body.min_y == 120);
+  REQUIRE(body.max_x == 139);
+  REQUIRE(body.max_y == 199);
+  REQUIRE(body.cells == 100 * 30 - 10 * 10 + 4 * 50);
+
+  // the outside and the hole, winding opposite ways
+  REQUIRE(body.loop_count == 2);
+
+  U32 first = 0;
+  F32 areas[2];
+
+  for (U32 loop = 0; loop < 2; ++loop) {
+    U32 end = body.loop_ends[loop];
+
+    for (U32 i = first; i < end; ++i) {
+      REQUIRE(body.points[i].x >= body.min_x);
+      REQUIRE(body.points[i].x <= body.max_x + 1);
+      REQUIRE(body.points[i].y >= body.min_y);
+      REQUIRE(body.points[i].y <= body.max_y + 1);
+    }
+
+    areas[loop] = loop_area(body.points + first, end - first) / 2;
+    first       = end;
+  }
+
+  REQUIRE(areas[0] * areas[1] < 0.0f);
+
+  // marching squares cuts the corners, by an eighth of a cell each
+  F32 area = std::abs(std::abs(areas[0]) - std::abs(areas[1]));
+  REQUIRE(std::abs(area - body.cells) < 4.0f);
+
+  // nothing changed, nothing found again
+  simulation::simulate();
+
+  REQUIRE(simulation::body_count() == 0);
+  REQUIRE(simulation::stats().chunks_labeled == 0);
+
+  simulation::set_parallel(true);
+}
+
+TEST_CASE("simulation_random", "[SIMULATION]") {
+  namespace random = simulation::random;
+
+  auto stream = random::stream(12, 3, 4);
+
+  REQUIRE(random::draw(stream, 7) == random::draw(stream, 7));
+  REQUIRE(random::draw(stream, 7) != random::draw(stream, 8));
+  REQUIRE(random::draw(stream, 7) !=
+          random::draw(random::stream(12, 4, 3), 7));
+  REQUIRE(random::draw(stream, 7) !=
+          random::draw(random::stream(13, 3, 4), 7));
+
+  U64 sum = 0;
+  U32 set = 0;
+
+  for (U32 counter = 0; counter < 1 << 16; ++counter) {
+    sum += random::chance(stream, counter);
+    set += __builtin_popcount(random::draw(stream, counter));
+  }
+
+  REQUIRE(std::abs(F64(sum) / (1 << 16) - 127.5) < 1.0);
+  REQUIRE(std::abs(F64(set) / (1 << 16) - 16.0) < 0.1);
+}